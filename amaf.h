@@ -32,10 +32,17 @@
 #include "size.h"
 #include <iostream>
 #include <iomanip>
+#include <climits>
 
+//Depth at which each point was first played in a simulation, by the side that
+//played it. Depths are stored added to a stamp that grows with every
+//simulation, so that set_up() does not have to clear the board: entries below
+//the stamp belong to previous simulations.
 class AmafBoard{
  private:
-  int board[MAXSIZE2+1];
+  static const int MAX_DEPTH = 3*MAXSIZE2;
+  int first[2][MAXPOINTS];  //Indexed by the side that played first, or 0.
+  int stamp;
   int size;
   bool side;
 
@@ -49,57 +56,47 @@ class AmafBoard{
   
   void clear()
   {
-    for (int i = 0; i <= size*size; i++) {
-      board[i] = 0;
+    for (int i = 0; i < MAXPOINTS; i++) {
+      first[0][i] = first[1][i] = 0;
     }
+    stamp = 1;
   }
 
   void set_up(bool sd, int sz)
   {
     size = sz;
     side = sd;
-    clear();
+    stamp += MAX_DEPTH + 1;
+    if (stamp > INT_MAX - (MAX_DEPTH + 1)) clear();
   }
 
-  int play(int coord, int depth)  //only for coord <= size2
+  void play(int coord, int depth)
   {
-    if (board[coord] == 0) {
-      board[coord] = side ? -depth : depth;
-      side = !side;
-      return 0;
-    } else {
-      side = !side; //Careful!
-      return -1;
+    if (coord && depth <= MAX_DEPTH && first[0][coord] < stamp && first[1][coord] < stamp) {
+      first[side][coord] = stamp + depth;
     }
+    side = !side;
   }
 
-  double value(int coord, int depth, bool side, double discount) const
-  {
-    if (coord == 0) return 0.0;
-    int val = side ? -board[coord] : board[coord];
-    if (val >= depth) {
-      return 1.0 - discount*val;
-    } else {
-      return 0;
-    }
-  }
+  //A move by side at depth or later is credited if entries[move] >= threshold.
+  const int *entries(bool sd) const { return first[sd]; }
+  int threshold(int depth) const { return stamp + depth; }
 
   void print() const{
     for (int y = size - 1; y > -1; y--) {
       std::cerr << "  |";
-      for (int x = 1; x < size+1; x++) {
-        
-        if (board[size*y + x] < 0) {
-          std::cerr << std::setw(3) << board[size*y + x] << "|";
-        } else if(board[size*y + x] > 0) {
-          std::cerr << std::setw(3) << board[size*y + x] << "|";
+      for (int x = 0; x < size; x++) {
+        int p = (y+1)*(size+1) + x+1;
+        if (first[0][p] >= stamp) {
+          std::cerr << std::setw(3) << first[0][p] - stamp << "|";
+        } else if(first[1][p] >= stamp) {
+          std::cerr << std::setw(3) << stamp - first[1][p] << "|";
         } else {
           std::cerr << "   |";
         }
       }
       std::cerr << "|" << "\n";
     }
-    std::cerr << "pass: " << board[0] << "\n";
   }
 };
 #endif
@@ -0,0 +1,142 @@
+/***************************************************************************************
+* Copyright (c) 2014, Antonio Garro.                                                   *
+* All rights reserved                                                                  *
+*                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are *
+* permitted provided that the following conditions are met:                            *
+*                                                                                      *
+* 1. Redistributions of source code must retain the above copyright notice, this list  *
+* of conditions and the following disclaimer.                                          *
+*                                                                                      *
+* 2. Redistributions in binary form must reproduce the above copyright notice, this    *
+* list of conditions and the following disclaimer in the documentation and/or other    *
+* materials provided with the distribution.                                            *
+*                                                                                      *
+* 3. Neither the name of the copyright holder nor the names of its contributors may be *
+* used to endorse or promote products derived from this software without specific      *
+* prior written permission.                                                            *
+*                                                                                      * 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"          *
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE            *
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE           *
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE            *
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL    *
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR           *
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER           *
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR     *
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF        *
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                    *
+***************************************************************************************/
+#ifndef BITBOARDH
+#define BITBOARDH
+#include "size.h"
+
+//One bit per point of the board, 0 included: sets of points with constant time
+//insertion and removal, and word-at-a-time union and counting.
+class Bitboard{
+ public:
+  static const int NWORDS = (MAXPOINTS + 63)/64;
+
+ private:
+  unsigned long long words[NWORDS];
+
+ public:
+  void clear()
+  {
+    for (int i = 0; i < NWORDS; i++) words[i] = 0;
+  }
+  bool test(int p) const { return (words[p >> 6] >> (p & 63)) & 1; }
+  void set(int p) { words[p >> 6] |= 1ULL << (p & 63); }
+  void reset(int p) { words[p >> 6] &= ~(1ULL << (p & 63)); }
+
+  int count() const
+  {
+    int n = 0;
+    for (int i = 0; i < NWORDS; i++) n += __builtin_popcountll(words[i]);
+    return n;
+  }
+
+  bool empty() const
+  {
+    unsigned long long any = 0;
+    for (int i = 0; i < NWORDS; i++) any |= words[i];
+    return any == 0;
+  }
+
+  Bitboard &operator|=(const Bitboard &other)
+  {
+    for (int i = 0; i < NWORDS; i++) words[i] |= other.words[i];
+    return *this;
+  }
+  Bitboard &operator&=(const Bitboard &other)
+  {
+    for (int i = 0; i < NWORDS; i++) words[i] &= other.words[i];
+    return *this;
+  }
+  Bitboard operator|(const Bitboard &other) const { Bitboard r = *this; return r |= other; }
+  Bitboard operator&(const Bitboard &other) const { Bitboard r = *this; return r &= other; }
+  Bitboard operator~() const
+  {
+    Bitboard r;
+    for (int i = 0; i < NWORDS; i++) r.words[i] = ~words[i];
+    return r;
+  }
+
+  //Shifts towards higher (<<) or lower (>>) points; 0 < n < 64.
+  Bitboard operator<<(int n) const
+  {
+    Bitboard r;
+    r.words[0] = words[0] << n;
+    for (int i = 1; i < NWORDS; i++) r.words[i] = (words[i] << n) | (words[i-1] >> (64 - n));
+    return r;
+  }
+  Bitboard operator>>(int n) const
+  {
+    Bitboard r;
+    for (int i = 0; i < NWORDS - 1; i++) r.words[i] = (words[i] >> n) | (words[i+1] << (64 - n));
+    r.words[NWORDS - 1] = words[NWORDS - 1] >> n;
+    return r;
+  }
+
+  //Iterates the points in the set in increasing order; 0 marks the end, so
+  //don't use it on sets that may contain point 0.
+  class Iterator{
+   private:
+    const unsigned long long *words;
+    unsigned long long current;
+    int word, point;
+   public:
+    Iterator(const Bitboard &bb): words(bb.words), current(bb.words[0]), word(0) { ++*this; }
+    void operator++()
+    {
+      while (current == 0) {
+        if (++word == NWORDS) {
+          point = 0;
+          return;
+        }
+        current = words[word];
+      }
+      point = 64*word + __builtin_ctzll(current);
+      current &= current - 1;
+    }
+    int operator*() const { return point; }
+    operator bool() const { return point != 0; }
+  };
+
+  //The n-th point in the set, from 0, or 0 if there are not so many: whole
+  //words are skipped by their count.
+  int nth(int n) const
+  {
+    for (int i = 0; i < NWORDS; i++) {
+      int nbits = __builtin_popcountll(words[i]);
+      if (n < nbits) {
+        unsigned long long word = words[i];
+        for (; n > 0; n--) word &= word - 1;
+        return 64*i + __builtin_ctzll(word);
+      }
+      n -= nbits;
+    }
+    return 0;
+  }
+};
+#endif
@@ -30,26 +30,33 @@
 //#define DEBUG_INFO
 #include <iostream>
 #include <ctime>
+#include <chrono>
+#include <thread>
 #include "engine.h"
 
 #define DEF_PLAYOUTS 3000
-#define DEF_TREESIZE 5000000
+#define DEF_TREE_MEMORY 360  //MB.
+#define DEF_PRUNE_VISITS 16
 
-Engine::Engine(Goban *goban):tree(DEF_TREESIZE, goban), amaf(goban->get_size())
+//Wall time in clock() units: clock() adds up the CPU time of every thread.
+static clock_t wall_clock()
 {
-  main_goban = goban;
-  max_playouts = DEF_PLAYOUTS;
-  max_time = 10*CLOCKS_PER_SEC;
-  max_time = INFINITE;
-  tree_size = DEF_TREESIZE;
-  rand_movs = 0;
+  using namespace std::chrono;
+  return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count()
+           * (CLOCKS_PER_SEC/1000000.0);
 }
 
-void Engine::reset()
+EngineSettings::EngineSettings()
 {
-  rand_movs = 0;
-  tree.clear();
-  amaf.set_up(main_goban->get_side(), main_goban->get_size());
+  max_playouts = DEF_PLAYOUTS;
+  max_time = 10*CLOCKS_PER_SEC;
+  max_time = INFINITE;
+  tree_memory = DEF_TREE_MEMORY << 20;
+  prune_visits = DEF_PRUNE_VISITS;
+  parallel_mode = Engine::TREE_PARALLEL;
+  ponder = false;
+  unsigned ncores = std::thread::hardware_concurrency();
+  nthreads = ncores ? ncores : 1;
 }
 
 void Engine::set_playouts(int playouts)
@@ -77,143 +84,465 @@ void Engine::set_times(int time_left, int stones)
   std::cerr << max_time << "\n";
 }
 
-int Engine::play_random_game(bool heavy)
+template<int N>
+SizedEngine<N>::SizedEngine(int size, const EngineSettings &settings):
+  Engine(settings), main_goban(size), tree(tree_memory, &main_goban, prune_visits)
 {
+  pondering = false;
+  stop = false;
+  set_threads(nthreads);
+}
+
+template<int N>
+SizedEngine<N>::~SizedEngine()
+{
+  stop_pondering();
+  set_threads(0);
+}
+
+template<int N>
+void SizedEngine<N>::reset()
+{
+  tree.clear();
+  for (unsigned i = 0; i < workers.size(); i++) {
+    if (workers[i]->tree) workers[i]->tree->clear();
+  }
+}
+
+template<int N>
+void SizedEngine<N>::report_move(int move)
+{
+  tree.promote(move);
+  for (unsigned i = 0; i < workers.size(); i++) {
+    if (workers[i]->tree) workers[i]->tree->promote(move);
+  }
+}
+
+template<int N>
+void SizedEngine<N>::drop_private_trees()
+{
+  for (unsigned i = 0; i < workers.size(); i++) {
+    delete workers[i]->tree;
+    workers[i]->tree = 0;
+  }
+}
+
+template<int N>
+int SizedEngine<N>::set_threads(int nthreads)
+{
+  drop_private_trees();  //Their size depends on the number of threads.
+  while ((int)workers.size() > nthreads) {
+    delete workers.back();
+    workers.pop_back();
+  }
+  while ((int)workers.size() < nthreads) {
+    Worker *worker = new Worker(main_goban.get_size());
+    worker->goban->set_seed(genrand64_int64());
+    workers.push_back(worker);
+  }
+  this->nthreads = workers.size();
+  return this->nthreads;
+}
+
+template<int N>
+void SizedEngine<N>::set_parallel_mode(int mode)
+{
+  parallel_mode = mode;
+  if (mode != ROOT_PARALLEL) drop_private_trees();
+}
+
+template<int N>
+void SizedEngine<N>::set_prune_visits(int visits)
+{
+  prune_visits = visits;
+  tree.set_prune_visits(visits);
+  for (unsigned i = 0; i < workers.size(); i++) {
+    if (workers[i]->tree) workers[i]->tree->set_prune_visits(visits);
+  }
+}
+
+//The trees are made again with the new budget, and start empty. Private
+//trees of root parallelization are made when the next search starts.
+template<int N>
+void SizedEngine<N>::set_tree_memory(size_t bytes)
+{
+  tree_memory = bytes;
+  tree.set_memory(bytes);
+  drop_private_trees();
+}
+
+template<int N>
+int SizedEngine<N>::play_random_game(Worker *worker, bool heavy)
+{
+  Goban<N> *goban = worker->goban;
   int pass = 0;
-  main_goban->shuffle_empty();
+  goban->shuffle_empty();
   while (pass < 2) {
-    int move = heavy ? main_goban->play_heavy() : main_goban->play_random();
-    amaf.play(move, ++simul_len);
-    rand_movs++;
-    if (move == Goban::PASS) pass++;
+    int move = heavy ? goban->play_heavy() : goban->play_random();
+    worker->amaf.play(move, ++worker->simul_len);
+    worker->rand_movs++;
+    if (move == Board::PASS) pass++;
     else pass = 0;
 #ifdef DEBUG_INFO
-      main_goban->print_goban();
+      goban->print_goban();
 #endif
-    int mercy = main_goban->mercy();    
+    int mercy = goban->mercy();    
     if (mercy != -1) {
       return 1-mercy;
     }
 //#ifdef DEBUG_INFO
-    if (simul_len > 2*main_goban->get_size2()) {
+    if (worker->simul_len > 2*goban->get_size2()) {
       std::cerr << "WARNING: Simulation exceeded max length.\n";
-      discarded++;
+      worker->discarded++;
       return -1;
     }
 //#endif
   }
-    return (main_goban->chinese_count() > 0) ? 1:0;
+    return (goban->chinese_count() > 0) ? 1:0;
 }
 
-int Engine::generate_move(bool early_pass)
+//Whether the search is over. Pondering goes on until stop_pondering().
+template<int N>
+bool SizedEngine<N>::search_done(const Tree *tree, int playouts) const
 {
-  const int EXPAND = 8;
-  const double RESIGN_THRESHOLD = 0.10, PASS_THRESHOLD = 0.90;
+  if (stop) return true;
+  if (pondering) return false;
+  return tree->get_root()->get_visits() >= playouts || wall_clock() - fin_clock >= max_time;
+}
+
+//Search threads also stop when the tree is full, for run_search() to make room.
+template<int N>
+bool SizedEngine<N>::stop_search(const Tree *tree, int playouts) const
+{
+  return tree->is_full() || search_done(tree, playouts);
+}
+
+//Keeps searching in the background, from the position after our own move, until
+//stop_pondering(). The tree is kept by report_move() for the move actually played.
+template<int N>
+void SizedEngine<N>::start_pondering()
+{
+  if (!ponder || pondering) return;
+  stop = false;
+  pondering = true;
+  ponder_thread = std::thread([this] { collect_trees(); run_search(); });
+}
+
+template<int N>
+void SizedEngine<N>::stop_pondering()
+{
+  if (!pondering) return;
+  stop = true;
+  ponder_thread.join();
+  pondering = false;
+  stop = false;
+}
+
+//Main loop of every search thread. Threads play on their own board, and grow
+//either the shared tree or a private one.
+template<int N>
+void SizedEngine<N>::search(Worker *worker, Tree *tree, int playouts)
+{
+  const int EXPAND = 8;  //Visits before expanding a node, while the tree is empty.
   
-  bool side = main_goban->get_side();
-  Node *root = tree.get_root();
-  rand_movs = 0, discarded = 0;
-  fin_clock = clock();
+  bool leaf_parallel = (parallel_mode == LEAF_PARALLEL);
+  Goban<N> *goban = worker->goban;
+  bool side = goban->get_side();
+  Node *root = tree->get_root();
 
-  while (root->get_visits() < max_playouts && clock() - fin_clock < max_time) {
+  while (!stop_search(tree, playouts)) {
     Node *node_history[3*MAXSIZE2];
     int nnode_hist = 0, pass = 0;
-    simul_len = 0;
-    amaf.set_up(main_goban->get_side(), main_goban->get_size());
+    worker->simul_len = 0;
+    worker->amaf.set_up(goban->get_side(), goban->get_size());
     Node *node = root;
     while (node->has_childs() && pass < 2) {
       node_history[nnode_hist++] = node;
       node = node->select_child();
       int move = node->get_move();
-      if(move == Goban::PASS) pass++;
+      if(move == Board::PASS) pass++;
       else pass = 0;
-      main_goban->play_move(move);
-      amaf.play(move, ++simul_len);
+      goban->play_move(move);
+      worker->amaf.play(move, ++worker->simul_len);
     }
-    if (node->get_visits() >= EXPAND || node == root) {
-      Prior priors[MAXSIZE2+1] = {{0,0}};
+    if ((node->get_visits() >= tree->expand_visits(EXPAND) || node == root)
+        && node->claim_expansion()  //Otherwise, another thread got here first.
+        && !tree->transpose(node, goban->get_situation_key(), nnode_hist)) {
+      Prior priors[MAXPOINTS] = {{0,0}};
       int legal_moves[MAXSIZE2+1];
-      int nlegal = main_goban->legal_moves(legal_moves);
-      //main_goban->init_priors(priors);
-      tree.expand(node, legal_moves, nlegal, priors); //TODO: break if expand fails.
+      int nlegal = goban->legal_moves(legal_moves);
+      goban->init_priors(priors);
+      tree->expand(node, legal_moves, nlegal, priors, goban->get_situation_key(), nnode_hist);
     }
     node_history[nnode_hist++] = node;
-    int result = play_random_game(HEAVY); //Black wins.
+    if (leaf_parallel) {
+      start_batch(node_history, nnode_hist);
+      playout(worker, side);
+      wait_batch();
+      back_up_results(node_history, nnode_hist, side, &workers[0], workers.size());
+    } else {
+      playout(worker, side);
+      back_up_results(node_history, nnode_hist, side, &worker, 1);
+    }
 #ifdef DEBUG_INFO
-      main_goban->print_goban();
-      std::cerr << result << "\n";
+      tree->print();
 #endif
-    main_goban->restore();
-    if (result == -1) continue;
-    if (side) result = 1-result;    
-    back_up_results(result, node_history, nnode_hist, side);
+  }
+}
+
+//Plays a game to the end from the current position of the worker's board, and
+//leaves the result, from the point of view of side, in worker->result.
+template<int N>
+void SizedEngine<N>::playout(Worker *worker, bool side)
+{
+  int result = play_random_game(worker, HEAVY); //Black wins.
 #ifdef DEBUG_INFO
-      tree.print();
+  worker->goban->print_goban();
+  std::cerr << result << "\n";
 #endif
+  worker->goban->restore();
+  if (result != -1 && side) result = 1-result;
+  worker->result = result;
+}
+
+//Leaf parallelization: helpers wait for the master to reach a leaf, walk the
+//same path on their own board, and play one game each from there.
+template<int N>
+void SizedEngine<N>::leaf_helper(Worker *worker, bool side)
+{
+  Goban<N> *goban = worker->goban;
+  int generation = 0;
+  while (true) {
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    while (batch.generation == generation && !batch.finished) batch.start.wait(lock);
+    if (batch.finished) return;
+    generation = batch.generation;
+    lock.unlock();
+
+    worker->simul_len = 0;
+    worker->amaf.set_up(goban->get_side(), goban->get_size());
+    for (int i = 1; i < batch.len; i++) {
+      int move = batch.path[i]->get_move();
+      goban->play_move(move);
+      worker->amaf.play(move, ++worker->simul_len);
+    }
+    playout(worker, side);
+
+    lock.lock();
+    if (--batch.pending == 0) batch.done.notify_one();
+  }
+}
+
+template<int N>
+void SizedEngine<N>::start_batch(Node *const node_history[], int nnodes)
+{
+  std::lock_guard<std::mutex> lock(batch.mutex);
+  batch.path = node_history;
+  batch.len = nnodes;
+  batch.pending = workers.size() - 1;
+  batch.generation++;
+  batch.start.notify_all();
+}
+
+template<int N>
+void SizedEngine<N>::wait_batch()
+{
+  std::unique_lock<std::mutex> lock(batch.mutex);
+  while (batch.pending) batch.done.wait(lock);
+}
+
+//Collects the nodes left behind by promotions, before a search: generate_move()
+//does it before starting the clock, so that it does not take the move's time.
+template<int N>
+void SizedEngine<N>::collect_trees()
+{
+  tree.collect();
+  for (unsigned i = 0; i < workers.size(); i++) {
+    if (workers[i]->tree) workers[i]->tree->collect();
+  }
+}
+
+//Searches the position of main_goban with every thread, until stop_search() says so.
+template<int N>
+void SizedEngine<N>::run_search()
+{
+  //Root parallelization: independent trees, one per thread, summed up at the end.
+  bool root_parallel = (parallel_mode == ROOT_PARALLEL);
+  bool leaf_parallel = (parallel_mode == LEAF_PARALLEL);
+  int nworkers = workers.size();
+  //In 64 bits: max_playouts is INFINITE under time controls.
+  int playouts = root_parallel ? ((long long)max_playouts + nworkers - 1)/nworkers : max_playouts;
+  for (int i = 0; i < nworkers; i++) {
+    Worker *worker = workers[i];
+    worker->goban->set_position(&main_goban);
+    worker->rand_movs = 0, worker->discarded = 0;
+    if (root_parallel && worker->tree == 0) {
+      worker->tree = new Tree(tree_memory/nworkers, worker->goban, prune_visits);
+    }
   }
+  bool full;
+  do {
+    batch.generation = 0, batch.pending = 0;
+    batch.finished = false;
+    std::vector<std::thread> threads;
+    for (int i = 1; i < nworkers; i++) {
+      if (leaf_parallel) {
+        threads.push_back(std::thread(&SizedEngine::leaf_helper, this, workers[i], main_goban.get_side()));
+      } else {
+        Tree *search_tree = root_parallel ? workers[i]->tree : &tree;
+        threads.push_back(std::thread(&SizedEngine::search, this, workers[i], search_tree, playouts));
+      }
+    }
+    search(workers[0], root_parallel ? workers[0]->tree : &tree, playouts);
+    if (leaf_parallel) {
+      std::lock_guard<std::mutex> lock(batch.mutex);
+      batch.finished = true;
+      batch.start.notify_all();
+    }
+    for (unsigned i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    //A full tree only ends a round: room is made in it, and the search goes on.
+    full = false;
+    for (int i = 0; i < (root_parallel ? nworkers : 1); i++) {
+      Tree *search_tree = root_parallel ? workers[i]->tree : &tree;
+      if (search_tree->is_full() && !search_done(search_tree, playouts)) {
+        search_tree->reclaim();
+        full = true;
+      }
+    }
+  } while (full);
+  if (root_parallel) {
+    tree.clear();
+    for (int i = 0; i < nworkers; i++) {
+      tree.merge(workers[i]->tree);
+    }
+  }
+}
+
+template<int N>
+int SizedEngine<N>::generate_move(bool early_pass)
+{
+  const double RESIGN_THRESHOLD = 0.10, PASS_THRESHOLD = 0.90;
+  
+  collect_trees();
+  fin_clock = wall_clock();
+  run_search();
+
+  Node *root = tree.get_root();
   Node *best = tree.get_best();
   print_PV();
-  if (best->get_move() == Goban::PASS) return Goban::PASS;
+  if (best == 0 || best->get_move() == Board::PASS) return Board::PASS;
   if (best->get_value(1) < RESIGN_THRESHOLD) return -1;
-  if (early_pass && best->get_value(1) >= PASS_THRESHOLD && !root->get_move()) return Goban::PASS;
+  if (early_pass && best->get_value(1) >= PASS_THRESHOLD && !root->get_move()) return Board::PASS;
   return best->get_move();
 }
 
-void Engine::back_up_results(int result, Node *node_history[], int nnodes, bool side)
+//Backs up the games played from the last node of node_history: one in tree and root
+//parallelization, one per thread in leaf parallelization. Discarded games are skipped.
+template<int N>
+void SizedEngine<N>::back_up_results(Node *node_history[], int nnodes, bool side,
+                             Worker *const played[], int nplayed)
 {
+  int nvalid = 0, wins = 0;
+  for (int k = 0; k < nplayed; k++) {
+    if (played[k]->result != -1) {
+      nvalid++;
+      wins += played[k]->result;
+    }
+  }
+  if (nvalid == 0) {
+    for (int i = 1; i < nnodes; i++) node_history[i]->revert_virtual_loss();
+    return;
+  }
   for (int i = 0; i < nnodes; i++) {
-    node_history[i]->set_results(1-result); //Because root node belongs to opponent.
-    node_history[i]->set_amaf(result, amaf, side, i+1);
+    //Root node belongs to opponent; all others carry the virtual loss of select_child().
+    node_history[i]->set_results(nvalid - wins, nvalid, i > 0);
+    for (int k = 0; k < nplayed; k++) {
+      int result = played[k]->result;
+      if (result != -1) {
+        node_history[i]->set_amaf(i % 2 ? 1-result : result, played[k]->amaf, side, i+1);
+      }
+    }
     side = !side;
-    result = 1-result;
+    wins = nvalid - wins;
   }
 }
 
-void Engine::print_PV() const
+template<int N>
+void SizedEngine<N>::print_PV() const
 {
-  fin_clock = clock() - fin_clock;
+  fin_clock = wall_clock() - fin_clock;
   tree.print();
   int nplayouts = tree.get_root()->get_visits();
+  int rand_movs = 0, discarded = 0;
+  for (unsigned i = 0; i < workers.size(); i++) {
+    rand_movs += workers[i]->rand_movs;
+    discarded += workers[i]->discarded;
+  }
   std::cerr << "#Playouts: " << nplayouts
-            << ", average length: " << rand_movs/nplayouts
+            << ", average length: " << rand_movs/std::max(nplayouts, 1)
             << ", discarded: " << discarded << ", playouts/sec: "
-            << (float)nplayouts/fin_clock*CLOCKS_PER_SEC << "\n";
+            << (float)nplayouts/fin_clock*CLOCKS_PER_SEC
+            << ", threads: " << workers.size() << "\n";
 }
 
-float Engine::score(std::vector<int> *dead)
+template<int N>
+float SizedEngine<N>::score(std::vector<int> *dead)
 {
   const int PLAYOUTS = 5000;
+  Worker *worker = workers[0];
+  Goban<N> *goban = worker->goban;
   int score = 0;
-  int score_table[MAXSIZE2+1] = {0};
+  int score_table[MAXPOINTS] = {0};
+  goban->set_position(&main_goban);
   for (int i = 0; i < PLAYOUTS; i++) {
-    simul_len = 0;
-    play_random_game(LIGHT);
-    main_goban->score_area(score_table);
-    main_goban->restore();
-  }
-  for (int i = 1; i <= main_goban->get_size2(); i++) {
-    if (score_table[i] > PLAYOUTS/2) score_table[i] = 1;
-    else if (score_table[i] < -PLAYOUTS/2) score_table[i] = -1;
-    else score_table[i] = 0;
-    
-    if (dead && main_goban->get_value(i)
-        && score_table[i] !=  main_goban->get_value(i)) {
-      dead->insert(dead->end(), i);
-    }
+    worker->simul_len = 0;
+    play_random_game(worker, LIGHT);
+    goban->score_area(score_table);
+    goban->restore();
   }
-
-  for (int i = 1; i <= main_goban->get_size2(); i++) {
-    score += score_table[i];
+  for (int y = 0; y < main_goban.get_size(); y++) {
+    for (int x = 0; x < main_goban.get_size(); x++) {
+      int i = main_goban.get_point(x, y);
+      if (score_table[i] > PLAYOUTS/2) score_table[i] = 1;
+      else if (score_table[i] < -PLAYOUTS/2) score_table[i] = -1;
+      else score_table[i] = 0;
+      
+      if (dead && main_goban.get_value(i)
+          && score_table[i] !=  main_goban.get_value(i)) {
+        dead->insert(dead->end(), i);
+      }
+      score += score_table[i];
+    }
   }
-  return score - main_goban->get_komi();
+  return score - main_goban.get_komi();
 }
 
-void Engine::perft(int max)
+template<int N>
+void SizedEngine<N>::perft(int max)
 {
+  Worker *worker = workers[0];
+  worker->goban->set_position(&main_goban);
   for (int i = 0; i < max; i++) {
-    simul_len = 0;
-    play_random_game(LIGHT);
+    worker->simul_len = 0;
+    play_random_game(worker, LIGHT);
     std::cerr << "restoring\n";
-    main_goban->restore();
+    worker->goban->restore();
+  }
+}
+
+//Sizes other than those given a SizedEngine of their own use the generic one.
+Engine *Engine::create(int size, const EngineSettings &settings)
+{  //Expects a size up to MAXSIZE.
+  switch (size) {
+    case 9:
+      return new SizedEngine<9>(size, settings);
+    case 13:
+      return new SizedEngine<13>(size, settings);
+    case 19:
+      return new SizedEngine<19>(size, settings);
+    default:
+      return new SizedEngine<0>(size, settings);
   }
 }
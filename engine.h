@@ -30,6 +30,10 @@
 #ifndef ENGINEH
 #define ENGINEH
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "zobrist.h"
 #include "goban.h"
 #include "amaf.h"
@@ -37,31 +41,106 @@
 
 #define INFINITE -1u/2
 
-class Engine{
+//Search parameters given through GTP, kept when the board size changes.
+struct EngineSettings{
+  size_t tree_memory;  //Bytes, for all the trees of the engine.
+  int prune_visits, max_playouts, parallel_mode, nthreads;
+  bool ponder;
+  clock_t max_time, byo_time;
+  EngineSettings();
+};
+
+//What GTP sees of an engine, whatever the board size. The search itself is
+//done by a SizedEngine of the size of the board.
+class Engine : protected EngineSettings{
+ public:
+  enum {TREE_PARALLEL, ROOT_PARALLEL, LEAF_PARALLEL};
+
+  Engine(const EngineSettings &settings): EngineSettings(settings) {}
+  virtual ~Engine() {}
+  static Engine *create(int size, const EngineSettings &settings);
+  const EngineSettings &get_settings() const { return *this; }
+  void set_playouts(int playouts);
+  void set_times(int main_time, int byo_time, int stones);
+  void set_times(int time_left, int stones);
+  void set_ponder(bool on) { ponder = on; }
+
+  virtual Board *get_goban() = 0;
+  virtual void reset() = 0;
+  virtual int set_threads(int nthreads) = 0;
+  virtual void set_parallel_mode(int mode) = 0;
+  virtual void set_prune_visits(int visits) = 0;
+  virtual void set_tree_memory(size_t bytes) = 0;
+  virtual void start_pondering() = 0;
+  virtual void stop_pondering() = 0;
+  virtual float score(std::vector<int> *dead) = 0;
+  virtual int generate_move(bool early_pass) = 0;
+  virtual void perft(int max) = 0;
+  virtual void report_move(int move) = 0;
+};
+
+template<int N> class SizedEngine final : public Engine{
  private:
   const bool HEAVY = true, LIGHT = false;
+
+  //Everything a search thread owns. The tree is shared, but for root parallelization.
+  struct Worker{
+    Goban<N> *goban;
+    AmafBoard amaf;
+    Tree *tree;
+    int result, simul_len, rand_movs, discarded;
+    Worker(int size): goban(new Goban<N>(size)), amaf(size), tree(0), result(0),
+                      simul_len(0), rand_movs(0), discarded(0) {}
+    ~Worker() { delete tree; delete goban; }
+  };
+
+  //Leaf parallelization: the leaf the helpers must play out from, and its hand-off.
+  struct LeafBatch{
+    std::mutex mutex;
+    std::condition_variable start, done;
+    Node *const *path;
+    int len, generation, pending;
+    bool finished;
+  } batch;
   
-  Goban *main_goban;
-  int tree_size, max_playouts;
-  int rand_movs, simul_len, discarded;
+  Goban<N> main_goban;
   Tree tree;
-  AmafBoard amaf;
-  mutable clock_t fin_clock, max_time, byo_time;
+  std::vector<Worker*> workers;
+  std::thread ponder_thread;
+  bool pondering;
+  std::atomic<bool> stop;
+  mutable clock_t fin_clock;
 
   int get_best_move() const;
-  int play_random_game(bool heavy);
-  void back_up_results(int result, Node *node_history[], int nnodes, bool side);
+  int play_random_game(Worker *worker, bool heavy);
+  void collect_trees();
+  void run_search();
+  void search(Worker *worker, Tree *tree, int playouts);
+  void playout(Worker *worker, bool side);
+  void leaf_helper(Worker *worker, bool side);
+  void start_batch(Node *const node_history[], int nnodes);
+  void wait_batch();
+  bool search_done(const Tree *tree, int playouts) const;
+  bool stop_search(const Tree *tree, int playouts) const;
+  void drop_private_trees();
+  void back_up_results(Node *node_history[], int nnodes, bool side,
+                       Worker *const played[], int nplayed);
   void print_PV() const;
 
  public:
-  Engine(Goban *goban);
+  SizedEngine(int size, const EngineSettings &settings);
+  ~SizedEngine();
+  Board *get_goban() { return &main_goban; }
   void reset();
-  void set_playouts(int playouts);
-  void set_times(int main_time, int byo_time, int stones);
-  void set_times(int time_left, int stones);
+  int set_threads(int nthreads);
+  void set_parallel_mode(int mode);
+  void set_prune_visits(int visits);
+  void set_tree_memory(size_t bytes);
+  void start_pondering();
+  void stop_pondering();
   float score(std::vector<int> *dead);
   int generate_move(bool early_pass);
   void perft(int max);
-  void report_move(int move) { tree.promote(move); }
+  void report_move(int move);
 };
 #endif
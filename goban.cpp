@@ -28,20 +28,23 @@
 * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                    *
 ***************************************************************************************/
 #include "goban.h"
-Goban::Goban(int newsize)
-{
-  size = (newsize <= MAXSIZE) ? newsize : size;
-  size2 = size*size;
+template<int N>
+Goban<N>::Goban(int newsize): Topology<N>(newsize)
+{  //Expects N, or a size up to MAXSIZE if N is 0.
   komi = 0.5;
+  group_stamp = 0;
+  for (int i = 0; i < maxpoints; i++) {
+    tactics[BLACK][i].liberties = -1, tactics[WHITE][i].liberties = -1;
+  }
+  init_board();
+#ifdef BITBOARD_PLANES
+  init_planes();
+#endif
   clear();
-  init_adjacent();
-  init_diagonals();
-  init_vicinity();
-  init_distance();
-  init_manhattan();
 }
 
-void Goban::reset()
+template<int N>
+void Goban<N>::reset()
 {
   side = BLACK;
   ko_point = 0;
@@ -52,27 +55,48 @@ void Goban::reset()
   last_atari[BLACK] = 0, last_atari[WHITE] = 0;
   last_point = 0, last_point2 = 0;
   
-  for (int i = 0; i <= size2; i++) {
-    if (Group *point = points[i]) {
-      point->clear();
+  for (int i = 0; i < npoints; i++) {
+    if (points[i] == i) {
+      groups[i].clear();
     }
     points[i] = 0;
+    next_stone[i] = 0;
+    colors[i] = BORDER;
   }
+#ifdef BITBOARD_PLANES
+  stone_plane[BLACK].clear(), stone_plane[WHITE].clear();
+  legal_plane[BLACK].clear(), legal_plane[WHITE].clear();
+  eye_plane[BLACK].clear(), eye_plane[WHITE].clear();
+  stale = board_plane;
+#endif
   empty_points.clear();
-  for (int j = 0; j < size2; j++) {
-    empty_points.add(j+1);
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      colors[get_point(x, y)] = EMPTY;
+      empty_points.add(get_point(x, y));
+    }
   }
+  init_patterns();
 }
 
-void Goban::clear()
+template<int N>
+void Goban<N>::clear()
 {
   reset();
   handicap = 0;
   game_history.clear();
+  has_snapshot = false;
 }
 
-void Goban::restore()
+//Back to the position after game_history. The game is replayed only the first
+//time; after that, the snapshot taken then is copied back.
+template<int N>
+void Goban<N>::restore()
 {
+  if (has_snapshot) {
+    restore_snapshot();
+    return;
+  }
   reset();
   set_fixed_handicap(handicap);
   for (int i = 0; i < game_history.length(); i++) {
@@ -83,140 +107,145 @@ void Goban::restore()
       side = !side;
     }
   }
+  take_snapshot();
 }
 
-void Goban::init_adjacent()
+template<int N>
+void Goban<N>::take_snapshot()
 {
-  for (int k = 1; k <= size2; k++) {
-    int nadj = 0;
-    if (k <= size*(size-1)) {  //N
-      adjacent[k][nadj++] =  k + size;
-    }
-    if (k % size) {  //E
-      adjacent[k][nadj++] =  k + 1;
-    }
-    if (k > size) {  //S
-      adjacent[k][nadj++] = k - size;
-    }
-    if (k % size != 1) {  //W
-      adjacent[k][nadj++] = k -1;
-    }
-    adjacent[k][nadj] = 0;
+  snapshot.side = side;
+  snapshot.ko_point = ko_point;
+  snapshot.last_point = last_point, snapshot.last_point2 = last_point2;
+  snapshot.stones_on_board[BLACK] = stones_on_board[BLACK];
+  snapshot.stones_on_board[WHITE] = stones_on_board[WHITE];
+  snapshot.last_atari[BLACK] = last_atari[BLACK];
+  snapshot.last_atari[WHITE] = last_atari[WHITE];
+#ifdef ZOBRIST
+  snapshot.zobrist_key = zobrist.get_key();
+#endif
+  std::copy(points, points + npoints, snapshot.points);
+  std::copy(next_stone, next_stone + npoints, snapshot.next_stone);
+  std::copy(colors, colors + npoints, snapshot.colors);
+  std::copy(patterns, patterns + npoints, snapshot.patterns);
+  std::copy(groups, groups + npoints, snapshot.groups);
+#ifdef BITBOARD_PLANES
+  snapshot.stone_plane[BLACK] = stone_plane[BLACK];
+  snapshot.stone_plane[WHITE] = stone_plane[WHITE];
+  update_planes();
+  for (int c = 0; c < 2; c++) {
+    snapshot.legal_plane[c] = legal_plane[c], snapshot.eye_plane[c] = eye_plane[c];
   }
+#endif
+  snapshot.nempty = empty_points.length();
+  std::copy(empty_points.get_points(), empty_points.get_points() + snapshot.nempty,
+            snapshot.empty_points);
+  has_snapshot = true;
 }
 
-void Goban::init_diagonals()
+template<int N>
+void Goban<N>::restore_snapshot()
 {
+  side = snapshot.side;
+  ko_point = snapshot.ko_point;
+  last_point = snapshot.last_point, last_point2 = snapshot.last_point2;
+  stones_on_board[BLACK] = snapshot.stones_on_board[BLACK];
+  stones_on_board[WHITE] = snapshot.stones_on_board[WHITE];
+  last_atari[BLACK] = snapshot.last_atari[BLACK];
+  last_atari[WHITE] = snapshot.last_atari[WHITE];
+#ifdef ZOBRIST
+  zobrist.reset();
+  zobrist.set_key(snapshot.zobrist_key);
+#endif
+  std::copy(snapshot.points, snapshot.points + npoints, points);
+  std::copy(snapshot.next_stone, snapshot.next_stone + npoints, next_stone);
+  std::copy(snapshot.colors, snapshot.colors + npoints, colors);
+  std::copy(snapshot.patterns, snapshot.patterns + npoints, patterns);
+  std::copy(snapshot.groups, snapshot.groups + npoints, groups);
+#ifdef BITBOARD_PLANES
+  stone_plane[BLACK] = snapshot.stone_plane[BLACK];
+  stone_plane[WHITE] = snapshot.stone_plane[WHITE];
+  for (int c = 0; c < 2; c++) {
+    legal_plane[c] = snapshot.legal_plane[c], eye_plane[c] = snapshot.eye_plane[c];
+  }
+  stale.clear();
+#endif
+  empty_points.set_points(snapshot.empty_points, snapshot.nempty);
+}
 
-  for (int k = 1; k <= size2; k++) {
-    int ndiag = 0;
-    if (k <= size*(size-1) && k % size != 1) {  //NW
-      diagonals[k][ndiag++] =  k + size - 1;
-    }  
-    if (k <= size*(size-1) && k % size) {  //NE
-      diagonals[k][ndiag++] =  k + size + 1;
-    }
-    if (k > size && k % size) {  //SE
-      diagonals[k][ndiag++] = k - size +1;
-    }
-    if (k > size && k % size != 1) {  //SW
-      diagonals[k][ndiag++] = k - size -1;
-    }
-    diagonals[k][ndiag] = 0;
+template<int N>
+void Goban<N>::init_board()
+{
+  for (int p = 0; p < npoints; p++) {
+    int x = p % stride - 1, y = p/stride - 1;
+    int d = x < y ? x : y;
+    if (size - x - 1 < d) d = size - x - 1;
+    if (size - y - 1 < d) d = size - y - 1;
+    edge_distance[p] = d > 0 ? d : 0;
   }
 }
 
-//Precomputed 8 neighbours, to be used in pattern matching. Order matters.
-void Goban::init_vicinity()
-{  
-  for (int i = 0; i <= size2; i++) {
-    for (int j = 0; j < 16; j++) {
-      vicinity[i][j] = 0;
-    }
+//Points at exactly distance from point, ring[] must be of size >= 4*distance.
+template<int N>
+int Goban<N>::within_manhattan(int point, int distance, int ring[]) const
+{
+  int x = point % stride - 1, y = point/stride - 1, len = 0;
+  for (int dx = -distance; dx <= distance; dx++) {
+    if (x + dx < 0 || x + dx >= size) continue;
+    int dy = distance - (dx < 0 ? -dx : dx);
+    if (y + dy < size) ring[len++] = point + dx + dy*stride;
+    if (dy && y - dy >= 0) ring[len++] = point + dx - dy*stride;
   }
-  //Duplicate to calculate rotations,avoiding run-time modulo division:
-  for (int i = 0; i < 2; i++) {
-    for (int k = 1; k <= size2; k++) {
-      if (k <= size*(size-1)) {
-        if (k % size != 1) {  //NW
-          vicinity[k][0+8*i] =  k + size - 1;
-        }
-        vicinity[k][1+8*i] =  k + size;  //N
-      }
-      if (k % size ) {
-        if (k <= size*(size-1)) {  //NE
-          vicinity[k][2+8*i] =  k + size + 1;
-        }
-        vicinity[k][3+8*i] =  k + 1;  //E
-      }
-      if (k > size) {
-        if (k % size) {  //SE
-          vicinity[k][4+8*i] = k - size +1;
-        }
-        vicinity[k][5+8*i] = k - size;  //S
-      }
-      if (k % size != 1) {
-        if (k > size) {  //SW
-          vicinity[k][6+8*i] = k - size -1;
-        }
-        vicinity[k][7+8*i] = k - 1;  //W
+  return len;
+}
+
+template<int N>
+void Goban<N>::init_patterns()
+{
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      int point = get_point(x, y);
+      patterns[point] = 0;
+      for (int i = 0; i < 8; i++) {
+        patterns[point] |= colors[point + vicinity[i]] << 2*i;
       }
     }
   }
 }
 
-void Goban::init_distance()
+//Changes the colour of a point on the board, and the patterns of its neighbours:
+//the point is at the opposite direction from each of them.
+template<int N>
+void Goban<N>::set_color(int point, int color)
 {
-  for (int p = 0; p <= size2; p++) {
-    int d = (p-1)%size < (p-1)/size ? (p-1)%size : (p-1)/size;
-    if (size - (p-1)%size - 1 < d) {
-      d = size - (p-1)%size - 1;
-    }
-    if (size - (p-1)/size - 1 < d) {
-      d = size - (p-1)/size - 1;
-    }
-    distance_to_edge[p] = d;
+  colors[point] = color;
+#ifdef BITBOARD_PLANES
+  stale.set(point);
+#endif
+  for (int i = 0; i < 8; i++) {
+    int shift = 2*((i + 4) % 8);
+    unsigned short &pattern = patterns[point + vicinity[i]];
+    pattern = (pattern & ~(3 << shift)) | color << shift;
+#ifdef BITBOARD_PLANES
+    stale.set(point + vicinity[i]);
+#endif
   }
 }
 
-void Goban::init_manhattan()
+#ifdef BITBOARD_PLANES
+template<int N>
+void Goban<N>::init_planes()
 {
-  for (int p = 1; p <= size2; p++) {
-    for (int dis = 1; dis <= 4; dis++) {
-      int len = 0;
-      for (int d = 0; d <= dis; d++) {
-        if ((p-1)%size >= d && size-(p-1)/size-1 >= (dis-d) ) {
-          within_manhattan[p][dis-1][len++] = p - d + (dis-d)*size;
-        } else {
-          within_manhattan[p][dis-1][len++] = 0;
-        }
-        if (d != dis) {
-          if ((p-1)%size >= d && (p-1)/size >= (dis-d)) {
-            within_manhattan[p][dis-1][len++] = p - d - (dis-d)*size;
-          } else {
-            within_manhattan[p][dis-1][len++] = 0;
-          }
-        }
-        if (d != 0) {
-          if (size-(p-1)%size-1 >= d && size-(p-1)/size-1 >= (dis-d)) {
-            within_manhattan[p][dis-1][len++] = p + d + (dis-d)*size;
-          } else {
-            within_manhattan[p][dis-1][len++] = 0;
-          }
-          if (d != dis) {
-            if (size-(p-1)%size-1 >= d && (p-1)/size >= (dis-d)) {
-              within_manhattan[p][dis-1][len++] = p + d - (dis-d)*size;
-            } else {
-              within_manhattan[p][dis-1][len++] = 0;
-            }
-          }
-        }
-      }
+  board_plane.clear();
+  for (int y = 0; y < size; y++) {
+    for (int x = 0; x < size; x++) {
+      board_plane.set(get_point(x, y));
     }
   }
 }
+#endif
 
-int Goban::set_fixed_handicap(int newhandicap)
+template<int N>
+int Goban<N>::set_fixed_handicap(int newhandicap)
 {  //Expects newhandicap belonging to [2, 9].
   handicap = newhandicap;
   if (handicap) {
@@ -234,8 +263,10 @@ int Goban::set_fixed_handicap(int newhandicap)
   return -1;
 }
 
-int Goban::set_handicap(const int handicap[])
+template<int N>
+int Goban<N>::set_handicap(const int handicap[])
 {  
+  has_snapshot = false;
   for (int i = 0; i < 9 && handicap[i]; i++) {
     drop_stone(handicap[i], BLACK);
 #ifdef ZOBRIST
@@ -249,34 +280,29 @@ int Goban::set_handicap(const int handicap[])
   return 0;
 }
 
-int Goban::set_size(int newsize)
-{
-  size = (newsize <= MAXSIZE) ? newsize : size;
-  size2 = size*size;
-  init_adjacent();
-  init_diagonals();
-  init_vicinity();
-  init_distance();
-  init_manhattan();
-  clear();
-  return size;
-}
-
-void Goban::remove_empty(int point)
+template<int N>
+void Goban<N>::remove_empty(int point)
 {
   empty_points.remove(point);
 }
 
 
-int Goban::drop_stone(int point, bool color)
+template<int N>
+int Goban<N>::drop_stone(int point, bool color)
 {
   if (points[point] != 0) print_goban();
   
   PointSet<5> liberties;
   point_liberties(point, liberties);
   
+  next_stone[point] = 0;
   groups[point].set_up(point, color, liberties);
-  points[point] = &(groups[point]);
+  touch(&groups[point]);
+  points[point] = point;
+  set_color(point, color);
+#ifdef BITBOARD_PLANES
+  stone_plane[color].set(point);
+#endif
   remove_empty(point);
   stones_on_board[color]++;
 #ifdef ZOBRIST
@@ -287,56 +313,61 @@ int Goban::drop_stone(int point, bool color)
 #ifdef ZOBRIST
   zobrist.toggle_ko(ko_point);
 #endif
-  if (points[point]->get_nliberties() == 0) {    //suicide.
-      erase_neighbour(points[point]);
-  } else if (points[point]->has_one_liberty()) { //self-atari.
-    last_atari[color] = points[point] ;
+  const Group *group = group_at(point);
+  if (group->get_nliberties() == 0) {    //suicide.
+      erase_neighbour(group);
+  } else if (group->has_one_liberty()) { //self-atari.
+    last_atari[color] = group;
   }
   last_point2 = last_point;
   last_point = point;
   return point;
 }
 
-int Goban::handle_neighbours(int point)
+template<int N>
+int Goban<N>::handle_neighbours(int point)
 {
   int captured_lone = 0, ncapt_lone = 0;
   GroupSet<4> neighbours;
   int nneigh = neighbour_groups(point, neighbours);
   
   for (int i = 0; i < nneigh; i++) {
-    Group *current_neigh = neighbours[i];
-    if (current_neigh->get_color() == points[point]->get_color()) {
+    Group *current_neigh = get_group(neighbours[i]);
+    if (current_neigh->get_color() == color_at(point)) {
       merge_neighbour(point, current_neigh);
     } else {
       if (current_neigh->has_one_liberty()) {
         if (current_neigh->get_nstones() == 1) {  
           ncapt_lone++;
-          captured_lone = current_neigh->get_stone(0);
+          captured_lone = current_neigh->get_first_stone();
         }
         erase_neighbour(current_neigh);
       } else {
         current_neigh->erase_liberties(point);
+        touch(current_neigh);
         if (current_neigh->has_one_liberty()) {
           last_atari[current_neigh->get_color()] = current_neigh;
         }
       }
     }
   }
-  if (ncapt_lone == 1 && points[point]->get_nstones()== 1) {
+  if (ncapt_lone == 1 && group_at(point)->get_nstones()== 1) {
     return captured_lone;  //new ko point.
   } else {
     return 0;
   }
 }
 
-void Goban::merge_neighbour(int point, Group *neigh)
+template<int N>
+void Goban<N>::merge_neighbour(int point, const Group *neighbour)
 {
-  Group *group = points[point];
+  Group *group = get_group(group_at(point)), *neigh = get_group(neighbour);
   neigh->erase_liberties(point);
-  group->attach_group(neigh);
-  for (Group::StoneIterator st(neigh);  st; ++st) {
-    points[*st] = group;
+  for (Group::StoneIterator st(neigh, next_stone);  st; ++st) {
+    points[*st] = points[point];
   }
+  group->attach_group(neigh, next_stone);
+  touch(group);
   neigh->clear();
   if (neigh == last_atari[neigh->get_color()]) {
     last_atari[neigh->get_color()] = 0;
@@ -344,11 +375,17 @@ void Goban::merge_neighbour(int point, Group *neigh)
   }    
 }
 
-void Goban::erase_neighbour(Group *neigh)
+template<int N>
+void Goban<N>::erase_neighbour(const Group *neighbour)
 {
-  for (Group::StoneIterator st(neigh);  st; ++st) {
+  Group *neigh = get_group(neighbour);
+  for (Group::StoneIterator st(neigh, next_stone);  st; ++st) {
     points[*st] = 0;
+    set_color(*st, EMPTY);
     stones_on_board[neigh->get_color()]--;
+#ifdef BITBOARD_PLANES
+    stone_plane[neigh->get_color()].reset(*st);
+#endif
 #ifdef ZOBRIST
     zobrist.update(*st, neigh->get_color());
 #endif    
@@ -357,7 +394,8 @@ void Goban::erase_neighbour(Group *neigh)
     GroupSet<4> meta_neigh;
     int nmeta = neighbour_groups(*st, meta_neigh);
     for (int k = 0; k < nmeta; k++) {
-      meta_neigh[k]->add_liberties(*st);
+      get_group(meta_neigh[k])->add_liberties(*st);
+      touch(get_group(meta_neigh[k]));
       if (meta_neigh[k] == last_atari[meta_neigh[k]->get_color()]) {
         last_atari[meta_neigh[k]->get_color()] = 0;
       }
@@ -370,7 +408,8 @@ void Goban::erase_neighbour(Group *neigh)
   neigh->clear();
 }
 
-int Goban::play_move(int point)  //this move isn't stored in game_history.
+template<int N>
+int Goban<N>::play_move(int point)  //this move isn't stored in game_history.
 {
   if (point) {
     drop_stone(point, side);
@@ -383,8 +422,10 @@ int Goban::play_move(int point)  //this move isn't stored in game_history.
   return point;
 }
 
-int Goban::play_move(int point, bool color)
+template<int N>
+int Goban<N>::play_move(int point, bool color)
 {
+  has_snapshot = false;
   if (side != color) {      //two consecutive moves of the same color are 
     game_history.add(PASS); //represented by a pass inbetween.
   }
@@ -409,9 +450,12 @@ int Goban::play_move(int point, bool color)
   return point;
 }
 
-bool Goban::set_position(const PList &moves)
+template<int N>
+bool Goban<N>::set_position(const PList &moves)
 {
+  has_snapshot = false;
   for (int i = 0; i < moves.length(); i++) {
+    if (moves[i] < 0) return false;  //Not a point, e.g. a resignation.
     if (moves[i]) {
       if (!points[moves[i]] && is_legal(moves[i], side)) {
         drop_stone(moves[i], side);
@@ -421,6 +465,7 @@ bool Goban::set_position(const PList &moves)
         return false;
       }
     } else {
+      game_history.add(PASS);
       side = !side;
     }
   #ifdef ZOBRIST
@@ -430,7 +475,16 @@ bool Goban::set_position(const PList &moves)
   return true;
 }
 
-bool Goban::set_position(const Goban *original)
-{
+template<int N>
+bool Goban<N>::set_position(const Goban *original)
+{  //Turns this board into a copy of original, e.g. for a search thread.
+  komi = original->komi;
+  clear();
+  set_fixed_handicap(original->handicap);
   return set_position(original->game_history);
 }
+
+template class Goban<0>;
+template class Goban<9>;
+template class Goban<13>;
+template class Goban<19>;
@@ -33,51 +33,154 @@
 #include "group.h"
 #include "zobrist.h"
 #include "amaf.h"
+#include "random.h"
 
 #define ZOBRIST
+#define BITBOARD_PLANES
+
+//Liberties of a stone played at a point, valid while the pattern around the
+//point and the stamps of its adjacent groups (0 if none) are those stored.
+struct Tactics{
+  unsigned long long stamps[4];
+  unsigned short pattern;
+  short liberties;  //-1 if not computed yet.
+};
 
 struct Prior{
   double prior;
   double equiv;
 };
 
-class Goban{
+//What the GTP front end and the search tree see of a board, whatever its size.
+class Board{
+public:
+  static const int PASS = 0;
+  virtual ~Board() {}
+  virtual void clear() = 0;
+  virtual void set_komi(float newkomi) = 0;
+  virtual int set_fixed_handicap(int new_handicap) = 0;
+  virtual int play_move(int point, bool color) = 0;
+  virtual float get_komi() const = 0;
+  virtual bool get_side() const = 0;
+  virtual int get_size() const = 0;
+  virtual void print_goban() const = 0;
+};
+
+//N is the board size, or 0 for a board of any size given to the constructor.
+template<int N> class Goban final : public Board, private Topology<N>{
 private:
   static const bool BLACK = 0, WHITE = 1;
+  static const int EMPTY = 2, BORDER = 3;
+  using Topology<N>::size;
+  using Topology<N>::size2;
+  using Topology<N>::stride;   //size+1.
+  using Topology<N>::npoints;  //(size+2)*(size+1) + 1: see MAXPOINTS.
+  using Topology<N>::adjacent;
+  using Topology<N>::diagonals;
+  using Topology<N>::vicinity;
+  //Arrays indexed by point take npoints entries, or MAXPOINTS for Goban<0>:
+  using Topology<N>::maxpoints;
+  using Topology<N>::maxsize2;
   bool side;
   int ko_point;
-  int size, size2;
   float komi;
   int handicap;
   
-  //We won't use groups[0], so board is [1-362); initialized at 0.
-  Group *points [MAXSIZE2+1];  //The board.
-  //Pre-allocated groups:
-  Group groups[MAXSIZE2+1];
+  //The board: index in groups[] of the stone's group, or 0.
+  short points[maxpoints];
+  short next_stone[maxpoints];  //Stones of each group, as a 0-terminated list.
+  unsigned char colors[maxpoints];  //BLACK, WHITE, EMPTY or BORDER.
+  //Colours of the 8 neighbours of each point, 2 bits each, in vicinity[] order:
+  unsigned short patterns[maxpoints];
+  //Pre-allocated groups; a group's index is the point of one of its stones:
+  Group groups[maxpoints];
   int stones_on_board[2];
-  Group *last_atari[2];  //One for black, one for white.
+  const Group *last_atari[2];  //One for black, one for white.
   int last_point, last_point2;
+  //Groups are stamped from this counter when they change. It is never reset,
+  //not even by restore_snapshot(), so stamps are not reused for other groups:
+  unsigned long long group_stamp;
+  mutable Tactics tactics[2][maxpoints];  //One per point for each colour.
 
-  //Pre-computed topology:
-  int adjacent[MAXSIZE2+1][5];
-  int diagonals[MAXSIZE2+1][5];
-  int vicinity[MAXSIZE2+1][16];
-  int distance_to_edge[MAXSIZE2+1];
-  int within_manhattan[MAXSIZE2+1][4][20];
+  unsigned char edge_distance[maxpoints];  //0 for border points too.
+#ifdef BITBOARD_PLANES
+  //Stones of each colour, one bit per point, kept along with points[]:
+  Bitboard stone_plane[2];
+  Bitboard board_plane;
+  //Empty points where a stone of each colour would not be suicide, and its
+  //virtual eyes; update_planes() recomputes the points marked stale:
+  mutable Bitboard legal_plane[2], eye_plane[2];
+  mutable Bitboard stale;
+#endif
 
-  PointList<MAXSIZE2+1> empty_points;
+  PointList<maxsize2+1> empty_points;
   PointList<3*MAXSIZE2> game_history;
+  mutable Random rng;
+  //Copy of the playing state of a Goban: enough to go back to the root position
+  //of a search without replaying the game. Only the entries of points on the
+  //board of the arrays indexed by point are used.
+  struct Snapshot{
+    bool side;
+    int ko_point, last_point, last_point2;
+    int stones_on_board[2];
+    const Group *last_atari[2];
+    unsigned long long zobrist_key;
+    short points[maxpoints];
+    short next_stone[maxpoints];
+    unsigned char colors[maxpoints];
+    unsigned short patterns[maxpoints];
+    Group groups[maxpoints];
+#ifdef BITBOARD_PLANES
+    Bitboard stone_plane[2];
+    Bitboard legal_plane[2], eye_plane[2];
+#endif
+    int nempty;
+    int empty_points[maxsize2];
+  };
+  Snapshot snapshot;  //Position after game_history, valid if has_snapshot.
+  bool has_snapshot;
 
   //Zobrist key are REALLY cheap
 #ifdef ZOBRIST
   mutable Zobrist zobrist;
 #endif  
-  void init_adjacent();
-  void init_diagonals();
-  void init_vicinity();
-  void init_distance();
-  void init_manhattan();
+  void init_board();
+  void init_patterns();
+  void set_color(int point, int color);
+  void touch(Group *group)
+  {
+    group->set_stamp(++group_stamp);
+#ifdef BITBOARD_PLANES
+    stale |= group->get_liberties();
+#endif
+  }
+  int distance_to_edge(int point) const { return edge_distance[point]; }
+  //Neighbours of a point on the board with the given colour, read from its pattern:
+  //fields equal to the colour have both bits clear, and their low bits are summed
+  //into the top nibble by a multiplication.
+  int adjacent_count(int point, int color) const
+  {
+    unsigned differ = patterns[point] ^ color*0x5555u;
+    return (((~(differ | differ >> 1) & 0x4444u) >> 2)*0x1111u >> 12) & 7;
+  }
+  int diagonal_count(int point, int color) const
+  {
+    unsigned differ = patterns[point] ^ color*0x5555u;
+    return ((~(differ | differ >> 1) & 0x1111u)*0x1111u >> 12) & 7;
+  }
+  int within_manhattan(int point, int distance, int ring[]) const;
+#ifdef BITBOARD_PLANES
+  void init_planes();
+  Bitboard surrounded_plane(bool color) const;
+  void update_planes() const;
+#endif
   void reset();
+  void take_snapshot();
+  void restore_snapshot();
+
+  const Group *group_at(int point) const { return points[point] ? &groups[points[point]] : 0; }
+  bool color_at(int point) const { return colors[point] == WHITE; }
+  Group *get_group(const Group *group) { return groups + (group - groups); }
   
   //4-neighbours iterating methods:
   int point_liberties(int point) const;
@@ -93,8 +196,8 @@ private:
   //Playing methods:
   int drop_stone(int point, bool color);
   int handle_neighbours(int point);
-  void merge_neighbour(int point, Group *neighbour);
-  void erase_neighbour(Group *neighbour);
+  void merge_neighbour(int point, const Group *neighbour);
+  void erase_neighbour(const Group *neighbour);
   void remove_empty(int point);
   
   bool is_surrounded(int point, bool color, int consider_occupied=0) const;
@@ -104,7 +207,8 @@ private:
   
   //Heuristics:
   bool stones_around(int, int) const;
-  int total_liberties(int, bool, PList*, int, const Group*) const;
+  int total_liberties(int, bool, PList*, int enough=0, const Group *exclude=0) const;
+  int cached_liberties(int, bool) const;
   int atari_escapes(const Group*, PList&) const;
   bool gains_liberties(int, const Group*) const;
   bool is_self_atari(int, bool) const;
@@ -127,18 +231,17 @@ private:
   bool match_mogo_pattern(int,bool) const;
   
 public:
-  static const int PASS = 0;
-  Goban(int size = 9);
+  Goban(int size = N);
   void clear();
   void restore();
   void set_komi(float newkomi) { komi = newkomi; }
-  int set_size(int new_size);
   int set_handicap(const int handicap[]);
   int set_fixed_handicap(int new_handicap);
   bool set_position(const PList &moves);
   bool set_position(const Goban *original);
 
-  void shuffle_empty() { empty_points.shuffle(); }
+  void set_seed(unsigned long long seed) { rng.set_seed(seed); }
+  void shuffle_empty() { empty_points.shuffle(rng); }
   int play_move(int point);
   int play_move(int point, bool color);
   int play_random();
@@ -149,6 +252,7 @@ public:
   int get_size() const { return size; }
   int get_size2() const { return size2; }
   int get_last_point() const { return last_point; }
+  int get_point(int x, int y) const { return (y+1)*stride + x+1; }
   bool is_occupied(int point) const { return points[point] != 0; }
   int get_value(int point) const;  
   int legal_moves(int moves[]) const;
@@ -162,6 +266,7 @@ public:
   unsigned long long get_zobrist() const;
   unsigned long long get_zobrist(int) const;
   unsigned long long set_zobrist(int) const;
+  unsigned long long get_situation_key() const { return zobrist.get_key(side, ko_point); }
 #endif
 };
 
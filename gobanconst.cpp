@@ -31,12 +31,14 @@
 #include "goban.h"
 
 #ifdef ZOBRIST
-unsigned long long Goban::get_zobrist() const
+template<int N>
+unsigned long long Goban<N>::get_zobrist() const
 {
   return zobrist.get_key();
 }
 
-unsigned long long Goban::get_zobrist(int move)const
+template<int N>
+unsigned long long Goban<N>::get_zobrist(int move)const
 {
   unsigned long long zob_backup = get_zobrist();
   unsigned long long new_zobrist = set_zobrist(move);
@@ -44,7 +46,8 @@ unsigned long long Goban::get_zobrist(int move)const
   return new_zobrist;
 }
 
-unsigned long long Goban::set_zobrist(int move) const
+template<int N>
+unsigned long long Goban<N>::set_zobrist(int move) const
 {
   if (move) {
     zobrist.update(move, side);
@@ -53,10 +56,10 @@ unsigned long long Goban::set_zobrist(int move) const
     int nneigh = neighbour_groups(move, neighbours);
     
     for (int i = 0; i < nneigh; i++) {
-      Group *current_neigh = neighbours[i];
+      const Group *current_neigh = neighbours[i];
       if (current_neigh->get_color() != side) {
         if (current_neigh->has_one_liberty()) {
-          for (Group::StoneIterator st(current_neigh); st; ++st) {
+          for (Group::StoneIterator st(current_neigh, next_stone); st; ++st) {
             zobrist.update(*st, current_neigh->get_color());
           }
         }
@@ -67,39 +70,39 @@ unsigned long long Goban::set_zobrist(int move) const
   return get_zobrist();
 }
 #endif
-int Goban::point_liberties(int point, PList &liberties) const
+template<int N>
+int Goban<N>::point_liberties(int point, PList &liberties) const
 {  // liberties must be of size > 4.
-  for (int i = 0; int adj=adjacent[point][i]; i++) {
-    if (points[adj] == 0) {
-      liberties.add(adj);
+  for (int i = 0; i < 4; i++) {
+    if (colors[point + adjacent[i]] == EMPTY) {
+      liberties.add(point + adjacent[i]);
     }
   }
   return liberties.length();
 }
 
-int Goban::point_liberties(int point) const
+template<int N>
+int Goban<N>::point_liberties(int point) const
 {
-  int nlibs = 0;
-  for (int i = 0; adjacent[point][i]; i++) {
-    if (points[adjacent[point][i]] == 0) nlibs++;
-  }
-  return nlibs;
+  return adjacent_count(point, EMPTY);
 }
 
-int Goban::neighbour_groups(int point, GroupSet<4> &neighbours) const
+template<int N>
+int Goban<N>::neighbour_groups(int point, GroupSet<4> &neighbours) const
 {
-  for (int i = 0; adjacent[point][i]; i++) {
-    neighbours.add(points[adjacent[point][i]]);
+  for (int i = 0; i < 4; i++) {
+    neighbours.add(group_at(point + adjacent[i]));
   }
   return neighbours.length();  
 }
 
-int Goban::neighbour_groups(int point, bool color, int max_liberties,
+template<int N>
+int Goban<N>::neighbour_groups(int point, bool color, int max_liberties,
                             GroupSet<MAXSIZE2/3> *neighbours) const
 {
   int nneigh = 0;
-  for (int i = 0; adjacent[point][i]; i++) {
-    Group *current_group = points[adjacent[point][i]];
+  for (int i = 0; i < 4; i++) {
+    const Group *current_group = group_at(point + adjacent[i]);
     if (current_group && current_group->get_color() == color
                      && current_group->get_nliberties() <= max_liberties) {
       if (neighbours) neighbours->add(current_group);
@@ -109,16 +112,18 @@ int Goban::neighbour_groups(int point, bool color, int max_liberties,
   return nneigh;  
 }
 
-int Goban::neighbour_groups(const Group *group, bool color, int max_liberties,
+template<int N>
+int Goban<N>::neighbour_groups(const Group *group, bool color, int max_liberties,
                             GroupSet<MAXSIZE2/3> &neighbours) const
 {
-  for (Group::StoneIterator st(group); st; ++st) {
+  for (Group::StoneIterator st(group, next_stone); st; ++st) {
     neighbour_groups(*st, color, max_liberties, &neighbours);
   }
   return neighbours.length();
 }
 
-int Goban::neighbours_size(int point, bool color) const
+template<int N>
+int Goban<N>::neighbours_size(int point, bool color) const
 {
   int nstones = 0;
   GroupSet<4> neighbours;
@@ -132,7 +137,8 @@ int Goban::neighbours_size(int point, bool color) const
   return nstones;
 }
 
-int Goban::neighbours_in_atari(int point, bool color, const GroupSet<4> &neighbours) const
+template<int N>
+int Goban<N>::neighbours_in_atari(int point, bool color, const GroupSet<4> &neighbours) const
 {
   int natari = 0;
   for (int i = 0; i < neighbours.length(); i++) {
@@ -143,71 +149,108 @@ int Goban::neighbours_in_atari(int point, bool color, const GroupSet<4> &neighbo
   return natari;
 }
 
-bool Goban::is_surrounded(int point, bool color, int consider_occupied) const
+template<int N>
+bool Goban<N>::is_surrounded(int point, bool color, int consider_occupied) const
 {
-  if (points[point] != 0) return false;
-  for (int i = 0; int adj=adjacent[point][i]; i++) {
-    if (adj == consider_occupied) continue;
-    if (points[adj] == 0 || points[adj]->get_color() != color) {
-      return false;
-    }
-  }
-  return true;
+  if (colors[point] != EMPTY) return false;
+  int nsurrounding = adjacent_count(point, color) + adjacent_count(point, BORDER);
+  if (nsurrounding == 4) return true;
+  if (nsurrounding < 3 || consider_occupied == 0) return false;
+  int offset = consider_occupied - point;
+  return (offset == 1 || offset == -1 || offset == stride || offset == -stride)
+         && colors[consider_occupied] != color;
 }
 
-bool Goban::is_true_eye(int point, bool color, int consider_occupied) const
+template<int N>
+bool Goban<N>::is_true_eye(int point, bool color, int consider_occupied) const
 {
-  int i, ncontrolled = 0;
   if (!is_surrounded(point, color, consider_occupied)) return false;
-  for (i = 0; int diag=diagonals[point][i]; i++) {
-    if (points[diag]) {
-      if (points[diag]->get_color() == color) {
-          ncontrolled++;
-      }
-    } else {
-      if (is_surrounded(diag, color, consider_occupied)) {
-        ncontrolled++;
-      }
+  int ndiag = 4 - diagonal_count(point, BORDER);
+  int ncontrolled = diagonal_count(point, color);
+  if (diagonal_count(point, EMPTY)) {
+    for (int i = 0; i < 4; i++) {
+      if (is_surrounded(point + diagonals[i], color, consider_occupied)) ncontrolled++;
     }
   }
-  if (i == 4) {
+  if (ndiag == 4) {
     if (ncontrolled > 2) return true;
-  } else if (ncontrolled == i) {
+  } else if (ncontrolled == ndiag) {
     return true;
   }
   return false;
 }
 #define FALSE_EYES
 #ifdef FALSE_EYES
-bool Goban::is_virtual_eye(int point, bool color) const
+template<int N>
+bool Goban<N>::is_virtual_eye(int point, bool color) const
 {
   if (!is_surrounded(point, color)) return false;
-  int nopponent = 0;
-  for (int i = 0; i < 4; i++) {
-    if (int diag = diagonals[point][i]) {
-      if (points[diag] && points[diag]->get_color() != color) {
-        nopponent++;                                          
-      } 
-    } else {
-      nopponent++;
-      break;
-    }
-  }
-  return nopponent < 2;
+  bool edge = diagonal_count(point, BORDER) > 0;
+  return diagonal_count(point, !color) + edge < 2;
 }
 #else
-bool Goban::is_virtual_eye(int point, bool color) const
+template<int N>
+bool Goban<N>::is_virtual_eye(int point, bool color) const
 {
   if (!is_surrounded(point, color)) return false;
-  for (int i = 0; int adj=adjacent[point][i]; i++) {
-    if (points[adj]->has_one_liberty()) return false;
+  for (int i = 0; i < 4; i++) {
+    const Group *group = group_at(point + adjacent[i]);
+    if (group && group->has_one_liberty()) return false;
   }
   return true;   
 }
 #endif
 
-bool Goban::is_legal(int point, bool color) const
-{  //asumes an empty point in the range [1, size2]
+#ifdef BITBOARD_PLANES
+//Empty points whose neighbours are all stones of color. Border points are
+//not in board_plane, so they never count against being surrounded.
+template<int N>
+Bitboard Goban<N>::surrounded_plane(bool color) const
+{
+  Bitboard open = board_plane & ~stone_plane[color];
+  Bitboard touched = (open << stride) | (open >> stride) | (open << 1) | (open >> 1);
+  return board_plane & ~(stone_plane[BLACK] | stone_plane[WHITE] | touched);
+}
+
+//Both suicide and eyes only depend on the 3x3 block around a point and on
+//which groups next to it are in atari: set_color() marks the blocks around
+//every change of colour stale, and touch() the liberties of changed groups.
+//Points next to an empty one are legal and no eyes; only crowded ones are
+//looked at one by one.
+template<int N>
+void Goban<N>::update_planes() const
+{
+  stale &= board_plane;
+  Bitboard empty = board_plane & ~(stone_plane[BLACK] | stone_plane[WHITE]);
+  Bitboard open = (empty << stride) | (empty >> stride) | (empty << 1) | (empty >> 1);
+  Bitboard crowded = stale & empty & ~open;
+  Bitboard easy = stale & ~crowded;
+  for (int c = 0; c < 2; c++) {
+    legal_plane[c] = (legal_plane[c] & ~easy) | (easy & empty);
+    eye_plane[c] &= ~easy;
+  }
+  for (Bitboard::Iterator p(crowded); p; ++p) {
+    //Legal next to a group of the same colour out of atari, or capturing one:
+    bool legal[2] = {false, false};
+    for (int i = 0; i < 4; i++) {
+      if (const Group *group = group_at(*p + adjacent[i])) {
+        legal[group->get_color() ^ group->has_one_liberty()] = true;
+      }
+    }
+    for (int c = 0; c < 2; c++) {
+      if (legal[c]) legal_plane[c].set(*p);
+      else legal_plane[c].reset(*p);
+      if (is_virtual_eye(*p, c)) eye_plane[c].set(*p);
+      else eye_plane[c].reset(*p);
+    }
+  }
+  stale.clear();
+}
+#endif
+
+template<int N>
+bool Goban<N>::is_legal(int point, bool color) const
+{  //asumes an empty point on the board
   if (point == ko_point) return false;
 #ifdef ZOBRIST
   if (zobrist.check_history(get_zobrist(point))) return false;
@@ -224,7 +267,26 @@ bool Goban::is_legal(int point, bool color) const
   return neighbours_in_atari(point, color, neighbours) > 0;
 }
 
-int Goban::legal_moves(int moves[]) const
+#ifdef BITBOARD_PLANES
+//Ko and superko are not local to a point: they are checked here.
+template<int N>
+int Goban<N>::legal_moves(int moves[]) const
+{
+  update_planes();
+  int nlegal = 0;
+  for (Bitboard::Iterator p(legal_plane[side]); p; ++p) {
+    if (*p == ko_point) continue;
+#ifdef ZOBRIST
+    if (zobrist.check_history(get_zobrist(*p))) continue;
+#endif
+    moves[nlegal++] = *p;
+  }
+  moves[nlegal++] = PASS;
+  return nlegal;
+}
+#else
+template<int N>
+int Goban<N>::legal_moves(int moves[]) const
 {
   int nlegal = 0;
   for (int i = 0; i < empty_points.length(); i++) {
@@ -236,21 +298,45 @@ int Goban::legal_moves(int moves[]) const
   moves[nlegal++] = PASS;
   return nlegal;
 }
+#endif
 
-int Goban::get_value(int point) const   //Value 1 for Black, -1 for White, 0 for empty.
+template<int N>
+int Goban<N>::get_value(int point) const   //Value 1 for Black, -1 for White, 0 for empty.
 {
   if (points[point]) {
-    return points[point]->get_color() ? -1:1;
+    return color_at(point) ? -1:1;
   }
   return 0;
 }
 
-float Goban::chinese_count() const
+#ifdef BITBOARD_PLANES
+template<int N>
+float Goban<N>::chinese_count() const
+{
+  Bitboard black_eyes = surrounded_plane(BLACK);
+  Bitboard white_eyes = surrounded_plane(WHITE) & ~black_eyes;
+  int black_score = stone_plane[BLACK].count() + black_eyes.count();
+  int white_score = stone_plane[WHITE].count() + white_eyes.count();
+  return black_score - white_score - komi;
+}
+
+template<int N>
+void Goban<N>::score_area(int point_list[]) const
+{
+  Bitboard white_area = stone_plane[WHITE] | surrounded_plane(WHITE);
+  Bitboard black_area = stone_plane[BLACK] | (surrounded_plane(BLACK) & ~white_area);
+  for (Bitboard::Iterator p(black_area); p; ++p) point_list[*p]++;
+  for (Bitboard::Iterator p(white_area); p; ++p) point_list[*p]--;
+}
+#else
+template<int N>
+float Goban<N>::chinese_count() const
 {
   int black_score = 0, white_score = 0, eyes_result = 0;
-  for (int i = 1; i <= size2; i++) {
+  for (int i = 0; i < npoints; i++) {
+    if (colors[i] == BORDER) continue;
     if (points[i]) {
-      if (points[i]->get_color()) white_score++;
+      if (color_at(i)) white_score++;
       else black_score++;
     } else {
       if (is_surrounded(i, BLACK)) eyes_result++;
@@ -260,11 +346,13 @@ float Goban::chinese_count() const
   return eyes_result + black_score - white_score - komi;
 }
 
- void Goban::score_area(int point_list[]) const
+template<int N>
+void Goban<N>::score_area(int point_list[]) const
 {
-  for (int i = 1; i <= size2; i++) {
+  for (int i = 0; i < npoints; i++) {
+    if (colors[i] == BORDER) continue;
     if (points[i]) {
-      if (points[i]->get_color()) point_list[i]--;
+      if (color_at(i)) point_list[i]--;
       else point_list[i]++;
     } else {
       if (is_surrounded(i, WHITE)) point_list[i]--;
@@ -272,8 +360,10 @@ float Goban::chinese_count() const
     }
   }
 }
+#endif
 
-int Goban::mercy() const
+template<int N>
+int Goban<N>::mercy() const
 {
   for (int s = 0; s < 2; s++) {
     if (stones_on_board[s] - stones_on_board[1-s] > size2/3) {
@@ -283,18 +373,19 @@ int Goban::mercy() const
   return -1;
 }
 
-void Goban::print_goban() const
+template<int N>
+void Goban<N>::print_goban() const
 {
   std::cerr << "   ";
   for (int i = 0; i<size; i++) std::cerr << "--";
   std::cerr << "\n";
   for (int y = size - 1; y > -1; y--) {
     std::cerr << "  |";
-    for (int x = 1; x < size+1; x++) {
-      if (points[size*y + x]) {
-        if (points[size*y + x]->get_color()) std::cerr << "#";
+    for (int x = 0; x < size; x++) {
+      if (points[get_point(x, y)]) {
+        if (color_at(get_point(x, y))) std::cerr << "#";
         else std::cerr << "o";
-        if (size*y + x == last_point) std::cerr << "!";
+        if (get_point(x, y) == last_point) std::cerr << "!";
         else std::cerr << " ";
       } else {
           std::cerr << ". ";
@@ -311,7 +402,12 @@ void Goban::print_goban() const
 #ifdef ZOBRIST
   std::cerr << "\nZobrist: " << zobrist.get_key();
 #endif
-  int lat1 = (last_atari[BLACK] ? last_atari[BLACK]->get_stone(0): 0);
-  int lat2 = (last_atari[WHITE] ? last_atari[WHITE]->get_stone(0) : 0);
+  int lat1 = (last_atari[BLACK] ? last_atari[BLACK]->get_first_stone(): 0);
+  int lat2 = (last_atari[WHITE] ? last_atari[WHITE]->get_first_stone() : 0);
   std::cerr << " last atari: black " << lat1<< " white " << lat2 << "\n";
 }
+
+template class Goban<0>;
+template class Goban<9>;
+template class Goban<13>;
+template class Goban<19>;
@@ -32,68 +32,59 @@
 Group::Group()
 {
   color = 0;
-  stones[0] = 0;
-  liberties[0] = 0;
+  liberties.clear();
+  head = 0, tail = 0;
   nsts = 0;
   nlibs = 0;
+  stamp = 0;
 }
 
 void Group::set_up(int point, bool new_color, const PList &new_liberties)
-{
+{  //The board must set next_stone[point] to 0.
   color = new_color;
-  nsts = 0;
-  stones[nsts++] = point;
-  stones[nsts] = 0;
-  nlibs = 0;
+  head = point, tail = point;
+  nsts = 1;
+  liberties.clear();
   for (int i = 0; i < new_liberties.length(); i++) {
-    liberties[nlibs++] = new_liberties[i];
-    liberties[nlibs] = 0;
+    liberties.set(new_liberties[i]);
   }
+  nlibs = new_liberties.length();
 }
 
-int Group::add_liberties(int i)
+int Group::add_liberties(int lib)
 {
-  for (int j = 0; j < nlibs; j++) {
-    if (liberties[j] == i) return 0;
-  }
-  liberties[nlibs++] = i;
-  liberties[nlibs] = 0;
-  return nlibs;
+  if (liberties.test(lib)) return 0;
+  liberties.set(lib);
+  return ++nlibs;
 }
 
 int Group::erase_liberties(int lib)
 {
-  for (int j = 0; j < nlibs; j++) {
-    if (liberties[j] == lib) {
-      liberties[j] = liberties[--nlibs];
-      liberties[nlibs]  = 0;
-      return nlibs;
-    }
-  }
-  return 0;
+  if (!liberties.test(lib)) return 0;
+  liberties.reset(lib);
+  return --nlibs;
 }
 
 void Group::clear()
 {
+  head = 0, tail = 0;
   nsts = 0;
-  stones[nsts] = 0;
   nlibs = 0;
-  liberties[nlibs] = 0;
+  liberties.clear();
 }
 
-void Group::attach_group(Group *attached)
-{  
-  for (int i = 0; i < attached->nsts; i++) {
-    this->stones[nsts++] = attached->stones[i];
-    this->stones[nsts] = 0;
-  }
-  for (int i = 0; i < attached->nlibs; i++) {
-    this->add_liberties(attached->liberties[i]);
-  }
+void Group::attach_group(const Group *attached, short next_stone[])
+{
+  next_stone[tail] = attached->head;
+  tail = attached->tail;
+  nsts += attached->nsts;
+  liberties |= attached->liberties;
+  nlibs = liberties.count();
 }
-void Group::print_group() const
+
+void Group::print_group(const short next_stone[]) const
 {
   std::cerr << "Color: " << color;
-  for (int i = 0; i < nsts; i++) std::cerr << " " << stones[i];
+  for (StoneIterator st(this, next_stone); st; ++st) std::cerr << " " << *st;
   std::cerr << "\n";
 }
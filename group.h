@@ -31,6 +31,7 @@
 #define GROUPH
 
 #include "size.h"
+#include "bitboard.h"
 #include <iostream>
 #include <algorithm>
 
@@ -43,55 +44,58 @@ class PList{
 
 };
 
+//Groups are kept by the board in an array, and referred to by their index
+//in it. Stones are linked through the next_stone[] array of the board.
 class Group{
  private:
+  Bitboard liberties;
+  short head, tail;
+  short nsts, nlibs;
   bool color;
-  int stones[MAXSIZE2];
-  int nsts;
-  int liberties[MAXSIZE2*2/3];
-  int nlibs;
+  unsigned long long stamp;  //Given by the board on every change.
 
  public:
   Group();
   void set_up(int point, bool color, const PList &liberties);
   void clear();
-  void attach_group(Group *attached);
+  void attach_group(const Group *attached, short next_stone[]);
   
   bool get_color() const { return color; }
   int get_nstones() const { return nsts; }
-  int get_stone(int i) const { return stones[i]; }
-  const int *get_stones() const { return stones; }
+  int get_first_stone() const { return head; }
+  unsigned long long get_stamp() const { return stamp; }
+  void set_stamp(unsigned long long new_stamp) { stamp = new_stamp; }
   
   int get_nliberties() const { return nlibs; }
-  int get_liberty(int i) const { return liberties[i]; }
-  const int *get_liberties() const { return liberties; }
+  int get_liberty(int i) const { return liberties.nth(i); }
+  const Bitboard &get_liberties() const { return liberties; }
   
   class StoneIterator{
-   protected:
-    const int *it;
+   private:
+    const short *next_stone;
+    int stone;
    public:
-    StoneIterator() { it = 0; }
-    StoneIterator(const Group *gr) { it = gr->get_stones(); }
-    void operator++() { ++it; }
-    int operator*() const { return *it; }
-    operator bool() const { return *it != 0; }
+    StoneIterator(const Group *gr, const short *next): next_stone(next), stone(gr->head) {}
+    void operator++() { stone = next_stone[stone]; }
+    int operator*() const { return stone; }
+    operator bool() const { return stone != 0; }
   };
   
-  class LibertyIterator : public StoneIterator{
+  class LibertyIterator : public Bitboard::Iterator{
    public:
-    LibertyIterator(const Group *gr) { it = gr->get_liberties(); }
+    LibertyIterator(const Group *gr): Bitboard::Iterator(gr->liberties) {}
   };
   
   bool has_one_liberty() const { return nlibs == 1; }
   bool has_two_liberties() const { return nlibs == 2; }
   int add_liberties(int lib);
   int erase_liberties(int lib);
-  void print_group() const;
+  void print_group(const short next_stone[]) const;
 };
 
 template<const int S> class GroupSet{
  protected:
-  Group *groups[S];
+  const Group *groups[S];
   int multiplicity[S];
   int len;
 
@@ -102,7 +106,7 @@ template<const int S> class GroupSet{
     groups[0] = 0;
   }
 
-  bool add(Group *gr)
+  bool add(const Group *gr)
   {
     if (gr == 0) return false;
     for (int i = 0; i < len; i++) {
@@ -116,7 +120,7 @@ template<const int S> class GroupSet{
     return true;
   }
 
-  Group *operator[](int i) const { return groups[i]; }
+  const Group *operator[](int i) const { return groups[i]; }
   int get_multiplicity(int i) const
   {
     #ifdef DEBUG_INFO
@@ -170,8 +174,15 @@ public:
 
   int operator[](int i) const { return points[i]; }
   int length() const { return len; }
+  const int *get_points() const { return points; }
+  void set_points(const int *list, int n)
+  {
+    std::copy(list, list + n, points);
+    len = n;
+    points[len] = 0;
+  }
 
-  void shuffle() { std::random_shuffle(points, points+len); }
+  template<class R> void shuffle(R &rng) { std::random_shuffle(points, points+len, rng); }
 
 };
 
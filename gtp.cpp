@@ -35,8 +35,9 @@
 
 using namespace std;
   
-GTP::GTP():go_engine(&main_goban)
+GTP::GTP():go_engine(Engine::create(9, EngineSettings()))
 {
+  main_goban = go_engine->get_goban();
   early_pass = true;
 }
 
@@ -107,6 +108,15 @@ int GTP::exec(){
   response = "=";
   response.append(cmd_id);
   
+  switch (cmd) {  //Only commands that don't touch the board nor the engine may run while pondering.
+    case PROTOCOL_VERSION: case NAME: case VERSION: case KNOWN_COMMAND:
+    case LIST_COMMANDS: case SHOWBOARD:
+      break;
+    default:
+      go_engine->stop_pondering();
+      break;
+  }
+
   switch (cmd) {
     case PROTOCOL_VERSION:
       protocol_version();
@@ -168,6 +178,21 @@ int GTP::exec(){
     case KGS_GENMOVE_CLEANUP:
       kgs_genmove_cleanup();
       break;
+    case THREADS:
+      threads();
+      break;
+    case PARALLEL:
+      parallel();
+      break;
+    case PONDER:
+      ponder();
+      break;
+    case PRUNE:
+      prune();
+      break;
+    case MEMORY:
+      memory();
+      break;
     default:
       unknown_command();
       break;
@@ -211,13 +236,13 @@ int GTP::char_to_coordinate(std::string &coordinate)
   if (!coordinate.compare("PASS")) return 0;
   
   std::stringstream auxstream(coordinate.substr(1,2));
-  if (auxstream >> coord && coord <= main_goban.get_size()) {
-    coord = (coord - 1)*main_goban.get_size();
+  if (auxstream >> coord && coord <= main_goban->get_size()) {
+    coord = coord*(main_goban->get_size() + 1);
   } else {
       return -1;
   }
   
-  for (int i = 0; i < main_goban.get_size(); i++) {
+  for (int i = 0; i < main_goban->get_size(); i++) {
     if (coordinate[0] == COORDINATES[i]) {
       coord += i+1;
       return coord;
@@ -231,14 +256,14 @@ void GTP::print_coordinate(int coord)
   if (coord == -1) {
     response.append("resign");
   } else {
-    coord_to_char(coord, response, main_goban.get_size());
+    coord_to_char(coord, response, main_goban->get_size());
   }
 }
 
 void GTP::perft(int max)
 {
   clock_t t = clock();
-  go_engine.perft(max);
+  go_engine->perft(max);
   t = clock() - t;
   float ts = (float)t/CLOCKS_PER_SEC;
   std::cerr << "Finish " << ts << ":" << max/ts << "pps.\n";
@@ -56,8 +56,8 @@ private:
 #ifdef LOG
   ofstream engine_log;
 #endif
-  Goban main_goban;
-  Engine go_engine;
+  Engine *go_engine;
+  Board *main_goban;  //The board of go_engine.
   void protocol_version();
   void name();
   void version();
@@ -79,17 +79,25 @@ private:
   void time_left();
   void final_score();
   void final_status_list();
+  void threads();
+  void parallel();
+  void ponder();
+  void prune();
+  void memory();
   
   enum {PROTOCOL_VERSION, NAME, VERSION, KNOWN_COMMAND, LIST_COMMANDS,
         QUIT, BOARDSIZE, CLEAR_BOARD, KOMI, PLAY, GENMOVE, SHOWBOARD,
         FIXED_HANDICAP, LEVEL,TIME_SETTINGS, TIME_LEFT, FINAL_SCORE,
-        FINAL_STATUS_LIST, KGS_TIME_SETTINGS, KGS_GENMOVE_CLEANUP, NCOMMANDS};
+        FINAL_STATUS_LIST, KGS_TIME_SETTINGS, KGS_GENMOVE_CLEANUP, THREADS,
+        PARALLEL, PONDER, PRUNE, MEMORY, NCOMMANDS};
 
   const std::string COMMANDS[NCOMMANDS]=
         {"protocol_version","name","version","known_command","list_commands",
          "quit","boardsize","clear_board","komi","play","genmove","showboard",
          "fixed_handicap","level","time_settings","time_left","final_score",
-         "final_status_list","kgs-time_settings", "kgs-genmove_cleanup"};
+         "final_status_list","kgs-time_settings", "kgs-genmove_cleanup",
+         "hara-threads", "hara-parallel", "hara-ponder", "hara-prune",
+         "hara-memory"};
       
   int parse(const std::string&);
   int string_to_cmd(const std::string&);
@@ -99,6 +107,7 @@ private:
   
 public:
   GTP();
+  ~GTP() { delete go_engine; }
   int GTP_loop();
   int exec();
   void perft(int);
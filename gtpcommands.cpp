@@ -70,11 +70,18 @@ void GTP::quit()
 void GTP::boardsize()
 {
   if(cmd_args.size() > 0){
-    if(cmd_int_args[0] != main_goban.set_size(cmd_int_args[0])){
+    int size = cmd_int_args[0];
+    if(size < 1 || size > MAXSIZE){
       response[0] = '?';
       response.append("unacceptable size");
     } else {
-      go_engine.reset();
+      //A new engine, with a board of the new size: the search is specialized on it.
+      float komi = main_goban->get_komi();
+      EngineSettings settings = go_engine->get_settings();
+      delete go_engine;
+      go_engine = Engine::create(size, settings);
+      main_goban = go_engine->get_goban();
+      main_goban->set_komi(komi);
     }
   } else {
     response[0] = '?';
@@ -84,14 +91,14 @@ void GTP::boardsize()
 
 void GTP::clear_board()
 {
-  main_goban.clear();
-  go_engine.reset();
+  main_goban->clear();
+  go_engine->reset();
 }
 
 void GTP::komi()
 {
   if(cmd_args.size() > 0){
-    main_goban.set_komi(cmd_int_args[0]);
+    main_goban->set_komi(cmd_int_args[0]);
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -107,11 +114,11 @@ void GTP::play()
     
     if(color > -1 && coord > -1){
       //Check legality.
-      if(main_goban.play_move(coord, color) == -1){
+      if(main_goban->play_move(coord, color) == -1){
         response[0] = '?';
         response.append("illegal move");
       } else {
-        go_engine.report_move(coord);
+        go_engine->report_move(coord);
       }
     } else {
       response[0] = '?';
@@ -134,14 +141,17 @@ void GTP::genmove()
 {
   if(cmd_args.size() > 0){
     bool color = char_to_color(cmd_args[0]);
-    if(color != main_goban.get_side()){
-      main_goban.play_move(0, !color);
-      go_engine.report_move(0);
+    if(color != main_goban->get_side()){
+      main_goban->play_move(0, !color);
+      go_engine->report_move(0);
+    }
+    int move = go_engine->generate_move(early_pass);
+    if (move != -1) {  //Resigning leaves the game as it is.
+      main_goban->play_move(move, color);
+      go_engine->report_move(move);
     }
-    int move = go_engine.generate_move(early_pass);
-    main_goban.play_move(move, color);
-    go_engine.report_move(move);
     print_coordinate(move);
+    if (move != -1) go_engine->start_pondering();
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -158,14 +168,14 @@ void GTP::unknown_command()
 
 void GTP::showboard()
 {
-  main_goban.print_goban();
+  main_goban->print_goban();
 }
 
 void GTP::fixed_handicap()
 {
   
   if(cmd_int_args.size() > 0 && cmd_int_args[0] > 1 && cmd_int_args[0] < 10){
-    if(main_goban.set_fixed_handicap(cmd_int_args[0]) != cmd_int_args[0]){
+    if(main_goban->set_fixed_handicap(cmd_int_args[0]) != cmd_int_args[0]){
     }
   } else {
     response[0] = '?';
@@ -176,7 +186,7 @@ void GTP::fixed_handicap()
 void GTP::level()
 {
   if(cmd_int_args.size() > 0 && cmd_int_args[0] > 0){
-    go_engine.set_playouts(10000*cmd_int_args[0]);
+    go_engine->set_playouts(10000*cmd_int_args[0]);
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -186,7 +196,7 @@ void GTP::level()
 void GTP::time_settings()
 {
   if(cmd_int_args.size() > 2){
-    go_engine.set_times(cmd_int_args[0], cmd_int_args[1], cmd_int_args[2]);
+    go_engine->set_times(cmd_int_args[0], cmd_int_args[1], cmd_int_args[2]);
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -198,11 +208,11 @@ void GTP::kgs_time_settings()
   if (cmd_int_args.size() > 3
       && (!cmd_args[0].compare("byoyomi")
           || !cmd_args[0].compare("canadian"))) {
-    go_engine.set_times(cmd_int_args[1], cmd_int_args[2], cmd_int_args[3]);
+    go_engine->set_times(cmd_int_args[1], cmd_int_args[2], cmd_int_args[3]);
   } else if (cmd_int_args.size() > 1 && !cmd_args[0].compare("absolute")) {
-    go_engine.set_times(cmd_int_args[1], 0, 0);
+    go_engine->set_times(cmd_int_args[1], 0, 0);
   } else if (cmd_int_args.size() > 0 && !cmd_args[0].compare("none")) {
-    go_engine.set_times(30, 0, 0); //To be adjusted.
+    go_engine->set_times(30, 0, 0); //To be adjusted.
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -212,7 +222,7 @@ void GTP::kgs_time_settings()
 void GTP::time_left()
 {
   if (cmd_args.size() > 2 && cmd_int_args.size() > 1) {
-    go_engine.set_times(cmd_int_args[1], cmd_int_args[2]);
+    go_engine->set_times(cmd_int_args[1], cmd_int_args[2]);
   } else {
     response[0] = '?';
     response.append("syntax error");
@@ -222,7 +232,7 @@ void GTP::time_left()
 void GTP::final_score()
 {
   std::stringstream auxstream;
-  float score = go_engine.score(0);
+  float score = go_engine->score(0);
   
   if (score > 0) {
     auxstream << score;
@@ -240,10 +250,10 @@ void GTP::final_status_list()
 {
   if (cmd_args.size() > 0 && !cmd_args[0].compare("dead")) {
     std::vector<int> list;
-    go_engine.score(&list);
+    go_engine->score(&list);
     //TODO: support 'alive' status.
     for(std::vector<int>::iterator it = list.begin(); it != list.end(); ++it){
-      coord_to_char(*it, response, main_goban.get_size());
+      coord_to_char(*it, response, main_goban->get_size());
       response.append("\n");
     }
   } else {
@@ -252,3 +262,59 @@ void GTP::final_status_list()
   }
 
 }
+
+void GTP::threads()
+{
+  if (cmd_int_args.size() > 0 && cmd_int_args[0] > 0) {
+    go_engine->set_threads(cmd_int_args[0]);
+  } else {
+    response[0] = '?';
+    response.append("syntax error");
+  }
+}
+
+void GTP::parallel()
+{
+  if (cmd_args.size() > 0 && !cmd_args[0].compare("tree")) {
+    go_engine->set_parallel_mode(Engine::TREE_PARALLEL);
+  } else if (cmd_args.size() > 0 && !cmd_args[0].compare("root")) {
+    go_engine->set_parallel_mode(Engine::ROOT_PARALLEL);
+  } else if (cmd_args.size() > 0 && !cmd_args[0].compare("leaf")) {
+    go_engine->set_parallel_mode(Engine::LEAF_PARALLEL);
+  } else {
+    response[0] = '?';
+    response.append("syntax error");
+  }
+}
+
+void GTP::ponder()
+{
+  if (cmd_args.size() > 0 && !cmd_args[0].compare("on")) {
+    go_engine->set_ponder(true);
+  } else if (cmd_args.size() > 0 && !cmd_args[0].compare("off")) {
+    go_engine->set_ponder(false);
+  } else {
+    response[0] = '?';
+    response.append("syntax error");
+  }
+}
+
+void GTP::prune()
+{
+  if (cmd_int_args.size() > 0 && cmd_int_args[0] >= 0) {
+    go_engine->set_prune_visits(cmd_int_args[0]);
+  } else {
+    response[0] = '?';
+    response.append("syntax error");
+  }
+}
+
+void GTP::memory()
+{
+  if (cmd_int_args.size() > 0 && cmd_int_args[0] > 0) {
+    go_engine->set_tree_memory((size_t)cmd_int_args[0] << 20);
+  } else {
+    response[0] = '?';
+    response.append("syntax error");
+  }
+}
@@ -29,10 +29,11 @@
 ***************************************************************************************/
 #include "goban.h"
 
-int Goban::random_choose(const PList &list, bool(Goban::*Policy)(int, bool) const) const
+template<int N>
+int Goban<N>::random_choose(const PList &list, bool(Goban::*Policy)(int, bool) const) const
 {
   if (list.length() == 0) return 0;
-  int first_choice = rand() % list.length();
+  int first_choice = rng(list.length());
   for (int i = first_choice; i < list.length(); i++) {
     int point = list[i];
     if ((this->*Policy)(point, side)) {
@@ -48,7 +49,8 @@ int Goban::random_choose(const PList &list, bool(Goban::*Policy)(int, bool) cons
   return PASS;
 }
 
-bool Goban::random_policy(int point, bool side) const
+template<int N>
+bool Goban<N>::random_policy(int point, bool side) const
 {  
   if (is_virtual_eye(point, side)) return false;
   if (!is_legal(point, side)) return false;
@@ -56,7 +58,8 @@ bool Goban::random_policy(int point, bool side) const
   return true;
 }
 
-bool Goban::heavy_policy(int point, bool side) const
+template<int N>
+bool Goban<N>::heavy_policy(int point, bool side) const
 {  
   if (is_virtual_eye(point, side)) return false;
   if (!is_legal(point, side)) return false;
@@ -65,12 +68,27 @@ bool Goban::heavy_policy(int point, bool side) const
   return true;
 }
 
-int Goban::play_random()
+template<int N>
+int Goban<N>::play_random()
 {
+#ifdef BITBOARD_PLANES
+  //Uniformly among the legal points that are not our eyes; a draw may still
+  //be the ko, or repeat a position.
+  update_planes();
+  Bitboard left = legal_plane[side] & ~eye_plane[side];
+  for (int n = left.count(); n > 0; n--) {
+    int point = left.nth(rng(n));
+    if (is_legal(point, side)) return play_move(point);
+    left.reset(point);
+  }
+  return play_move(PASS);
+#else
   return play_move(random_choose(empty_points, &Goban::random_policy));
+#endif
 }
 
-int Goban::play_heavy()
+template<int N>
+int Goban<N>::play_heavy()
 {
   if (int move = last_atari_heuristic()) {
     return play_move(move);
@@ -100,9 +118,10 @@ int Goban::play_heavy()
   return play_random();
 }
 
-int Goban::last_atari_heuristic() const
+template<int N>
+int Goban<N>::last_atari_heuristic() const
 {
-  if (Group *group = last_atari[!side]) {
+  if (const Group *group = last_atari[!side]) {
     int move = group->get_liberty(0);
     if (is_legal(move, side) &&
         !is_self_atari(move, side) &&
@@ -121,21 +140,22 @@ int Goban::last_atari_heuristic() const
   return 0;
 }
 
-void Goban::nakade_heuristic(int point, PList &list) const
+template<int N>
+void Goban<N>::nakade_heuristic(int point, PList &list) const
 {
   for (int i = 0; i < 8; i++) {
-    if (int v = vicinity[point][i]) {
-      if (points[v] == 0 && (creates_eyes(v, 0) > 1 || creates_eyes(v, 1) > 1)) {
-        list.add(v);
-      }
+    int v = point + vicinity[i];
+    if (colors[v] == EMPTY && (creates_eyes(v, 0) > 1 || creates_eyes(v, 1) > 1)) {
+      list.add(v);
     }
   }
 }
 
-void Goban::capture_heuristic(int point, PList &list) const
+template<int N>
+void Goban<N>::capture_heuristic(int point, PList &list) const
 {
   for (int i = 0; i < 8; i++) {
-    Group *group = points[vicinity[point][i]];
+    const Group *group = group_at(point + vicinity[i]);
     if (group && group->get_color() != side && group->has_one_liberty()) {
       //atari_escapes(group, list);??
       int lib = group->get_liberty(0);
@@ -146,12 +166,13 @@ void Goban::capture_heuristic(int point, PList &list) const
 }
 }
 
-void Goban::save_heuristic(int point, PList &list) const
+template<int N>
+void Goban<N>::save_heuristic(int point, PList &list) const
 {
-  if (points[point] && points[point]->get_nliberties() == 2) {
+  if (points[point] && group_at(point)->get_nliberties() == 2) {
     for (int i = 0; i < 2; i++) {
-      int lib = points[point]->get_liberty(i);
-      if (gains_liberties(lib, points[point])) {
+      int lib = group_at(point)->get_liberty(i);
+      if (gains_liberties(lib, group_at(point))) {
         list.add(lib);
       }
     }
@@ -165,70 +186,78 @@ void Goban::save_heuristic(int point, PList &list) const
   }
 /*TODO!!!
   for (int i = 0; i < 8; i++) {
-    if (int v = vicinity[point][i]) {
-      if (points[v] != 0 && points[v]->get_color() == side && points[v]->get_nliberties() == 1) {
-        atari_escapes(points[v], list);
-      }
+    int v = point + vicinity[i];
+    if (points[v] != 0 && color_at(v) == side && group_at(v)->get_nliberties() == 1) {
+      atari_escapes(group_at(v), list);
     }
   }
 */
 }
 
-void Goban::pattern_heuristic(int point, PList &list) const
+template<int N>
+void Goban<N>::pattern_heuristic(int point, PList &list) const
 {
   for (int i = 0; i < 8; i++) {
-    if (int v = vicinity[point][i]) {
-      if (points[v] == 0 && match_mogo_pattern(v, side)) {
-        list.add(v);
-      }
+    int v = point + vicinity[i];
+    if (colors[v] == EMPTY && match_mogo_pattern(v, side)) {
+      list.add(v);
     }
   }
 }
 
-bool Goban::stones_around(int point, int distance) const
+template<int N>
+bool Goban<N>::stones_around(int point, int distance) const
 {
-  for (int i = 0; i < distance; i++) {
-    for (int j = 0; j < 4*(i+1); j++) {
-      int v =  within_manhattan[point][i][j];
-      if (is_occupied(v)) return true;
+  for (int i = 1; i <= distance; i++) {
+    int ring[4*MAXSIZE];
+    int len = within_manhattan(point, i, ring);
+    for (int j = 0; j < len; j++) {
+      if (is_occupied(ring[j])) return true;
     }
   }
   return false;
 }
 
-int Goban::total_liberties(int point, bool color, PList *liberties, int enough=0, const Group *exclude=0) const
+//Liberties the group of a stone played at point would have. If enough is set,
+//counting may stop as soon as there are more than enough.
+template<int N>
+int Goban<N>::total_liberties(int point, bool color, PList *liberties, int enough, const Group *exclude) const
 {
-  PointSet<MAXSIZE2> libs;
-  if (liberties) point_liberties(point, *liberties);
-  point_liberties(point, libs);
-  if (enough && libs.length() > enough) return libs.length();
+  Bitboard libs;
+  libs.clear();
+  int nlibs = 0;
+  for (int i = 0; i < 4; i++) {
+    if (colors[point + adjacent[i]] == EMPTY) libs.set(point + adjacent[i]), nlibs++;
+  }
+  if (enough && nlibs > enough) return nlibs;
   
   GroupSet<4> neighbours;
   int nneigh = neighbour_groups(point, neighbours);
   for (int i = 0; i < nneigh; i++) {
     const Group *curr_neigh = neighbours[i];
-    if (curr_neigh != exclude) {
-      if (curr_neigh->get_color() == color) {
-        for (Group::LibertyIterator lib(curr_neigh); lib; ++lib) {
-          if (*lib != point) {
-            if (liberties) liberties->add(*lib);
-            libs.add(*lib);
-            if (enough && libs.length() > enough) return libs.length();
-          }
-        }
-      } else if (curr_neigh->get_nliberties() == 1) {
-        for (Group::StoneIterator st(curr_neigh); st; ++st) {
-          for (int j = 0; adjacent[*st][j]; j++) {
-            if (adjacent[*st][j] == point) {
-              libs.add(*st);
-              if (enough && libs.length() > enough) return libs.length();
-            } else if (points[adjacent[*st][j]] &&
-                       points[adjacent[*st][j]]->get_color() == color) {
-              for (int k = 0; k < nneigh; k++) {
-                if (points[adjacent[*st][j]] == neighbours[k]) {
-                  libs.add(*st);
-                  if (enough && libs.length() > enough) return libs.length();
-                }
+    if (curr_neigh != exclude && curr_neigh->get_color() == color) {
+      libs |= curr_neigh->get_liberties();
+    }
+  }
+  libs.reset(point);
+  if (liberties) {
+    for (Bitboard::Iterator lib(libs); lib; ++lib) liberties->add(*lib);
+  }
+  if (enough && (nlibs = libs.count()) > enough) return nlibs;
+
+  for (int i = 0; i < nneigh; i++) {
+    const Group *curr_neigh = neighbours[i];
+    if (curr_neigh != exclude && curr_neigh->get_color() != color
+        && curr_neigh->get_nliberties() == 1) {
+      for (Group::StoneIterator st(curr_neigh, next_stone); st; ++st) {
+        for (int j = 0; j < 4; j++) {
+          int adj = *st + adjacent[j];
+          if (adj == point) {
+            libs.set(*st);
+          } else if (points[adj] && color_at(adj) == color) {
+            for (int k = 0; k < nneigh; k++) {
+              if (group_at(adj) == neighbours[k]) {
+                libs.set(*st);
               }
             }
           }
@@ -236,10 +265,32 @@ int Goban::total_liberties(int point, bool color, PList *liberties, int enough=0
       }
     }
   }
-  return libs.length();
+  return libs.count();
+}
+
+//total_liberties(point, color, 0), remembered for the point and colour: it only
+//depends on the colours around the point and on the groups next to it.
+template<int N>
+int Goban<N>::cached_liberties(int point, bool color) const
+{
+  Tactics &entry = tactics[color][point];
+  unsigned long long stamps[4];
+  for (int i = 0; i < 4; i++) {
+    int adj = point + adjacent[i];
+    stamps[i] = points[adj] ? groups[points[adj]].get_stamp() : 0;
+  }
+  if (entry.liberties >= 0 && entry.pattern == patterns[point]
+      && std::equal(stamps, stamps + 4, entry.stamps)) {
+    return entry.liberties;
+  }
+  entry.liberties = total_liberties(point, color, 0);
+  entry.pattern = patterns[point];
+  std::copy(stamps, stamps + 4, entry.stamps);
+  return entry.liberties;
 }
 
-bool Goban::gains_liberties(int point, const Group *group) const
+template<int N>
+bool Goban<N>::gains_liberties(int point, const Group *group) const
 {
   int curr_liberties = 1;
   if (group) curr_liberties = group->get_nliberties();
@@ -247,19 +298,23 @@ bool Goban::gains_liberties(int point, const Group *group) const
   return nlibs > curr_liberties;
 }
 
-bool Goban::is_self_atari(int point, bool color) const
+template<int N>
+bool Goban<N>::is_self_atari(int point, bool color) const
 {
-  return (total_liberties(point, color, 0, 1) == 1);
+  if (adjacent_count(point, EMPTY) > 1) return false;
+  return (cached_liberties(point, color) == 1);
 }
 
-int Goban::atari_last_liberty(int point, bool color) const
+template<int N>
+int Goban<N>::atari_last_liberty(int point, bool color) const
 {
-  PointSet<MAXSIZE2> liberties;
+  PointList<MAXSIZE2> liberties;
   if (total_liberties(point, color, &liberties, 1) == 1) return liberties[0]; //Maybe 0!
   return -1;
 }
 
-int Goban::atari_escapes(const Group *group, PList &escapes) const
+template<int N>
+int Goban<N>::atari_escapes(const Group *group, PList &escapes) const
 {
   for (Group::LibertyIterator lib(group); lib; ++lib) {
     if (gains_liberties(*lib, group)) {
@@ -278,9 +333,11 @@ int Goban::atari_escapes(const Group *group, PList &escapes) const
   return escapes.length();
 }
 
-bool Goban::fast_ladder(int point, bool color) const
+template<int N>
+bool Goban<N>::fast_ladder(int point, bool color) const
 {
-  if (total_liberties(point, color, 0) != 2) return false;
+  if (adjacent_count(point, EMPTY) > 2) return false;
+  if (cached_liberties(point, color) != 2) return false;
   if (neighbour_groups(point, !color, 2, 0)) return false;
   PointList<5> liberties;
   point_liberties(point, liberties);
@@ -298,29 +355,30 @@ bool Goban::fast_ladder(int point, bool color) const
     }
     if (delta[1] == 0) return true;
     int p = point, act = 0;
-    while (distance_to_edge[p] > 1) {
+    while (distance_to_edge(p) > 1) {
       p = p + delta[act];
       //look for ladder breakers. TODO: complete.
       if (points[p]) {
-        if (points[p]->get_color() == color) break;
+        if (color_at(p) == color) break;
         else return true;
       }
       if (points[p + delta[act]]) {
-        if (points[p + delta[act]]->get_color() == color) break;
+        if (color_at(p + delta[act]) == color) break;
         else return true;
       }
       act = 1-act;
     }
-    if (distance_to_edge[p] < 2) return true;
+    if (distance_to_edge(p) < 2) return true;
   }
   return false;
 }
 
-int Goban::creates_eyes(int point, bool color) const
+template<int N>
+int Goban<N>::creates_eyes(int point, bool color) const
 {
   int neyes = 0;
-  for (int i = 0; adjacent[point][i]; i++) {
-    if (is_true_eye(adjacent[point][i], color, point)) {
+  for (int i = 0; i < 4; i++) {
+    if (is_true_eye(point + adjacent[i], color, point)) {
       neyes++;
     }
   }
@@ -332,7 +390,8 @@ int Goban::creates_eyes(int point, bool color) const
   return neyes;
 }
 
-bool Goban::bad_self_atari(int point, bool color) const
+template<int N>
+bool Goban<N>::bad_self_atari(int point, bool color) const
 {
   int last_lib = atari_last_liberty(point, color);
   if (last_lib == -1) return false;
@@ -342,7 +401,7 @@ bool Goban::bad_self_atari(int point, bool color) const
 
   //Only handle throw-ins up to 2 stones:?
   //if (neighbours_size(point, color) < 2) {
-    if (total_liberties(last_lib, !color, 0) < 2) {
+    if (cached_liberties(last_lib, !color) < 2) {
 #ifdef DEBUG_INFO
       std::cerr << "snapback\n";
 #endif  
@@ -364,13 +423,15 @@ bool Goban::bad_self_atari(int point, bool color) const
   return true;
 }
 
-int Goban::bulkiness(const Group *group, int point) const
+template<int N>
+int Goban<N>::bulkiness(const Group *group, int point) const
 {
   int max_bulkiness = 0;
-  for (Group::StoneIterator st(group); st; ++st) {
+  for (Group::StoneIterator st(group, next_stone); st; ++st) {
     int bulk = 0;
-    for (int i = 0; adjacent[*st][i]; i++) {
-      if (points[adjacent[*st][i]] == group || adjacent[*st][i] == point) {
+    for (int i = 0; i < 4; i++) {
+      int adj = *st + adjacent[i];
+      if (group_at(adj) == group || adj == point) {
         bulk++;
       }
     }
@@ -379,13 +440,14 @@ int Goban::bulkiness(const Group *group, int point) const
   return max_bulkiness;
 }
 
-int Goban::neighbour_bulkiness(int point, bool color) const
+template<int N>
+int Goban<N>::neighbour_bulkiness(int point, bool color) const
 {
   GroupSet<4> neighbours;
   int nneigh = neighbour_groups(point, neighbours);
   int max_bulkiness = nneigh;
   for (int i = 0; i < nneigh; i++) {
-    Group *neigh = neighbours[i];
+    const Group *neigh = neighbours[i];
     if (neigh->get_color() == color) {
       int bulk = bulkiness(neigh, point);
       if (bulk > max_bulkiness) max_bulkiness = bulk;
@@ -394,7 +456,8 @@ int Goban::neighbour_bulkiness(int point, bool color) const
   return max_bulkiness;
 }
 
-bool Goban::nakade_shape(int point, bool color) const
+template<int N>
+bool Goban<N>::nakade_shape(int point, bool color) const
 {
   int bulk = neighbour_bulkiness(point, color);
       
@@ -417,111 +480,120 @@ bool Goban::nakade_shape(int point, bool color) const
   return false;
 }
 
-//Hard-coded MoGo patterns, a bit nasty:
-bool Goban::match_mogo_pattern(int point, bool side) const
-{    
-  if (point == 1 || point == size || point == size2 || point == size*(size-1)+1) return false;  //filter corners.
-  
-  if (point > size && point % size && point <= size*(size-1) && point % size != 1) {
-    const int *vic = vicinity[point];
+//Hard-coded MoGo patterns, a bit nasty. color[] holds the colours of the 8
+//neighbours of the point, clockwise from NW, twice, as in vicinity[].
+static bool mogo_pattern(const int color[16], bool side)
+{
+  const int WHITE = 1, BORDER = 3;
+  bool stone[16], white[16], edge = false;
+  for (int i = 0; i < 16; i++) {
+    stone[i] = color[i] < 2;
+    white[i] = color[i] == WHITE;
+    edge |= color[i] == BORDER;
+  }
+  if (!edge) {
     for (int i = 1; i < 8; i+=2) {
-      if (points[vic[i]]) {
-        bool adj_color = points[vic[i]]->get_color();
-        if (points[vic[i-1]] && points[vic[i-1]]->get_color() != adj_color) {
-          if (points[vic[i+2]] == 0 && points[vic[i+6]] == 0) {
-            if (points[vic[i+1]] && points[vic[i+1]]->get_color() != adj_color) {
+      if (stone[i]) {
+        bool adj_color = white[i];
+        if (stone[i-1] && white[i-1] != adj_color) {
+          if (stone[i+2] == 0 && stone[i+6] == 0) {
+            if (stone[i+1] && white[i+1] != adj_color) {
               return true;  //Hane1
             }
-            if (points[vic[i+1]] == 0 && points[vic[i+4]] == 0) {
+            if (stone[i+1] == 0 && stone[i+4] == 0) {
               return true;  //Hane2
             }
           }
-          if (points[vic[i+2]] == 0 && points[vic[i+4]] == 0 &&
-              points[vic[i+6]] && points[vic[i+6]]->get_color() != adj_color) {
+          if (stone[i+2] == 0 && stone[i+4] == 0 &&
+              stone[i+6] && white[i+6] != adj_color) {
               return true;  //Hane3
           }
-          if (points[vic[i+6]] && points[vic[i+6]]->get_color() == adj_color) {
-            if ((points[vic[i+2]] || points[vic[i+4]] == 0 || points[vic[i+4]]->get_color() == adj_color) &&
-                (points[vic[i+4]] || points[vic[i+2]] == 0 || points[vic[i+2]]->get_color() == adj_color)) {
+          if (stone[i+6] && white[i+6] == adj_color) {
+            if ((stone[i+2] || stone[i+4] == 0 || white[i+4] == adj_color) &&
+                (stone[i+4] || stone[i+2] == 0 || white[i+2] == adj_color)) {
               return true;  //Cut1
             }
           }
         }
-        if (points[vic[i+1]] && points[vic[i+1]]->get_color() != adj_color) {
-          if (points[vic[i+2]] == 0 && points[vic[i+6]] == 0) {
-            if (points[vic[i-1]] == 0 && points[vic[i+4]] == 0) {
+        if (stone[i+1] && white[i+1] != adj_color) {
+          if (stone[i+2] == 0 && stone[i+6] == 0) {
+            if (stone[i-1] == 0 && stone[i+4] == 0) {
               return true;  //Mirror Hane2
             }
           }
-          if (points[vic[i+4]] == 0 && points[vic[i+6]] == 0 &&
-              points[vic[i+2]] && points[vic[i+2]]->get_color() != adj_color) {
+          if (stone[i+4] == 0 && stone[i+6] == 0 &&
+              stone[i+2] && white[i+2] != adj_color) {
               return true;  //Mirror Hane3
           }
         }
-        if (points[vic[i+2]] && points[vic[i+6]] && points[vic[i+2]]->get_color() != adj_color &&
-            points[vic[i+6]]->get_color() != adj_color &&
-            (points[vic[i+4]] == 0 || points[vic[i+4]]->get_color() == adj_color) &&
-            (points[vic[i+3]] == 0 || points[vic[i+3]]->get_color() == adj_color) &&
-            (points[vic[i+5]] == 0 || points[vic[i+5]]->get_color() == adj_color)) {
+        if (stone[i+2] && stone[i+6] && white[i+2] != adj_color &&
+            white[i+6] != adj_color &&
+            (stone[i+4] == 0 || white[i+4] == adj_color) &&
+            (stone[i+3] == 0 || white[i+3] == adj_color) &&
+            (stone[i+5] == 0 || white[i+5] == adj_color)) {
           return true;  //Cut2
         }
-        if (adj_color != side && points[vic[i-1]] && points[vic[i-1]]->get_color() == side &&
-            points[vic[i+2]] == 0 && points[vic[i+4]] == 0 && points[vic[i+6]] == 0 &&
-            points[vic[i+1]] && points[vic[i+1]]->get_color() == adj_color) {
+        if (adj_color != side && stone[i-1] && white[i-1] == side &&
+            stone[i+2] == 0 && stone[i+4] == 0 && stone[i+6] == 0 &&
+            stone[i+1] && white[i+1] == adj_color) {
           return true;  //Hane4
         }
-        if (adj_color != side && points[vic[i+1]] && points[vic[i+1]]->get_color() == side &&
-            points[vic[i+2]] == 0 && points[vic[i+4]] == 0 && points[vic[i+6]] == 0 &&
-            points[vic[i-1]] && points[vic[i-1]]->get_color() == adj_color) {
+        if (adj_color != side && stone[i+1] && white[i+1] == side &&
+            stone[i+2] == 0 && stone[i+4] == 0 && stone[i+6] == 0 &&
+            stone[i-1] && white[i-1] == adj_color) {
           return true;  //Mirror Hane4
         }
       }
     }
   } else {
+    int nborder = 0;
+    for (int i = 1; i < 8; i += 2) {
+      nborder += color[i] == BORDER;
+    }
+    if (nborder > 1) return false;  //filter corners.
     for (int i = 1; i < 8; i+=2) {
-      const int *vic = vicinity[point];
-      if (vic[i]) {
-        if (points[vic[i]]) {
-          if (vic[i+2] && points[vic[i+2]] && points[vic[i+2]]->get_color() != points[vic[i]]->get_color() &&
-             (vic[i+6]==0 || points[vic[i+6]] == 0 || points[vic[i+6]]->get_color() != points[vic[i]]->get_color())) {
+      if (color[i] != BORDER) {
+        if (stone[i]) {
+          if (stone[i+2] && white[i+2] != white[i] &&
+             (stone[i+6] == 0 || white[i+6] != white[i])) {
             return true;  //Side2
           }
-          if (vic[i+6] && points[vic[i+6]] && points[vic[i+6]]->get_color() != points[vic[i]]->get_color() &&
-             (vic[i+2]== 0 || points[vic[i+2]] == 0 || points[vic[i+2]]->get_color() != points[vic[i]]->get_color())) {
+          if (stone[i+6] && white[i+6] != white[i] &&
+             (stone[i+2] == 0 || white[i+2] != white[i])) {
             return true;  //Mirror Side2
           }
-          if (points[vic[i]]->get_color() == side) {
-            if ((vic[i+1] && points[vic[i+1]] && points[vic[i+1]]->get_color() != side)) {
+          if (white[i] == side) {
+            if (stone[i+1] && white[i+1] != side) {
               return true;  //Side3
             }
-            if ((vic[i-1] && points[vic[i-1]] && points[vic[i-1]]->get_color() != side)) {
+            if (stone[i-1] && white[i-1] != side) {
               return true;  //Mirror Side3
             }
           }
-          if (points[vic[i]]->get_color() != side) {
-            if (vic[i+1] && points[vic[i+1]] && points[vic[i+1]]->get_color() == side) {
-              if (vic[i+2] == 0 || points[vic[i+2]] == 0 || points[vic[i+2]]->get_color() == side) {
+          if (white[i] != side) {
+            if (stone[i+1] && white[i+1] == side) {
+              if (stone[i+2] == 0 || white[i+2] == side) {
                 return true;  //Side4
               }
-              if (vic[i+2] && points[vic[i+2]] && points[vic[i+2]]->get_color() != side
-                && vic[i+6] && points[vic[i+6]] && points[vic[i+6]]->get_color() == side) {
+              if (stone[i+2] && white[i+2] != side
+                && stone[i+6] && white[i+6] == side) {
                 return true; //Side5
               }
             }
-            if (vic[i-1] && points[vic[i-1]] && points[vic[i-1]]->get_color() == side) {
-              if (vic[i+6] == 0 || points[vic[i+6]] == 0 || points[vic[i+6]]->get_color() == side) {
+            if (stone[i-1] && white[i-1] == side) {
+              if (stone[i+6] == 0 || white[i+6] == side) {
                 return true;  //Mirror Side4
               }
-              if (vic[i+6] && points[vic[i+6]] && points[vic[i+6]]->get_color() != side &&
-                  vic[i+2] && points[vic[i+2]] && points[vic[i+2]]->get_color() == side) {
+              if (stone[i+6] && white[i+6] != side &&
+                  stone[i+2] && white[i+2] == side) {
                 return true; //Mirror Side5
               }
             }
           }
-        } else if ((vic[i+6] && points[vic[i+6]] && vic[i-1] && points[vic[i-1]] &&
-                    points[vic[i+6]]->get_color() != points[vic[i-1]]->get_color())
-               || (vic[i+2] && points[vic[i+2]] && vic[i+1] && points[vic[i+1]] &&
-                    points[vic[i+2]]->get_color() != points[vic[i+1]]->get_color())) {
+        } else if ((stone[i+6] && stone[i-1] &&
+                    white[i+6] != white[i-1])
+               || (stone[i+2] && stone[i+1] &&
+                    white[i+2] != white[i+1])) {
           return true;  //Side1 and mirror.
         }
       }
@@ -529,3 +601,34 @@ bool Goban::match_mogo_pattern(int point, bool side) const
   }
   return false;
 }
+
+//Whether the pattern of every neighbourhood code matches, for each side to move.
+static unsigned long long mogo_table[2][65536/64];
+
+static bool init_mogo_table()
+{
+  for (int code = 0; code < 65536; code++) {
+    int color[16];
+    for (int i = 0; i < 16; i++) {
+      color[i] = code >> 2*(i % 8) & 3;
+    }
+    for (int side = 0; side < 2; side++) {
+      if (mogo_pattern(color, side)) mogo_table[side][code/64] |= 1ULL << code%64;
+    }
+  }
+  return true;
+}
+
+static const bool mogo_table_ready = init_mogo_table();
+
+template<int N>
+bool Goban<N>::match_mogo_pattern(int point, bool side) const
+{
+  int code = patterns[point];
+  return mogo_table[side][code/64] >> code%64 & 1;
+}
+
+template class Goban<0>;
+template class Goban<9>;
+template class Goban<13>;
+template class Goban<19>;
@@ -30,7 +30,8 @@
 #include "goban.h"
 
 
-void Goban::init_priors(Prior priors[]) const
+template<int N>
+void Goban<N>::init_priors(Prior priors[]) const
 {
   const double EQUIV = size;// /2;
   priors[PASS].prior = 0.1*EQUIV, priors[PASS].equiv = EQUIV;
@@ -51,10 +52,10 @@ void Goban::init_priors(Prior priors[]) const
     }
     priors[p].prior = 0.5*EQUIV, priors[p].equiv = EQUIV;
     if(size > 11){
-      if(distance_to_edge[p] == 0 && !stones_around(p, 4)){
+      if(distance_to_edge(p) == 0 && !stones_around(p, 4)){
         priors[p].prior = 0.1*EQUIV, priors[p].equiv = EQUIV;
       }
-      else if(distance_to_edge[p] == 3 && !stones_around(p, 4)){
+      else if(distance_to_edge(p) == 3 && !stones_around(p, 4)){
         priors[p].prior = 0.9*EQUIV, priors[p].equiv = EQUIV;
       }
     }
@@ -103,12 +104,17 @@ void Goban::init_priors(Prior priors[]) const
 
   
   for(int i = 0; last_point && i < 4; i++){
-    for(int j = 0; j < 4*(i+1); j++){
-      int v =  within_manhattan[last_point][i][j];
-      if(v) {
-        priors[v].prior += (1.0-0.1*i)*EQUIV, priors[v].equiv += EQUIV;
-      }
+    int ring[4*4];
+    int len = within_manhattan(last_point, i+1, ring);
+    for(int j = 0; j < len; j++){
+      int v = ring[j];
+      priors[v].prior += (1.0-0.1*i)*EQUIV, priors[v].equiv += EQUIV;
     }
   }
   
 }
+
+template class Goban<0>;
+template class Goban<9>;
+template class Goban<13>;
+template class Goban<19>;
@@ -0,0 +1,57 @@
+/***************************************************************************************
+* Copyright (c) 2014, Antonio Garro.                                                   *
+* All rights reserved                                                                  *
+*                                                                                      *
+* Redistribution and use in source and binary forms, with or without modification, are *
+* permitted provided that the following conditions are met:                            *
+*                                                                                      *
+* 1. Redistributions of source code must retain the above copyright notice, this list  *
+* of conditions and the following disclaimer.                                          *
+*                                                                                      *
+* 2. Redistributions in binary form must reproduce the above copyright notice, this    *
+* list of conditions and the following disclaimer in the documentation and/or other    *
+* materials provided with the distribution.                                            *
+*                                                                                      *
+* 3. Neither the name of the copyright holder nor the names of its contributors may be *
+* used to endorse or promote products derived from this software without specific      *
+* prior written permission.                                                            *
+*                                                                                      * 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"          *
+* AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE            *
+* IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE           *
+* ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE            *
+* LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL    *
+* DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR           *
+* SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER           *
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR     *
+* TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF        *
+* THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                    *
+***************************************************************************************/
+#ifndef RANDOMH
+#define RANDOMH
+
+//xorshift64* generator. Every board owns one, so that threads don't share
+//(and serialize on) the state of rand().
+class Random{
+ private:
+  unsigned long long state;
+
+ public:
+  Random(unsigned long long seed = 0) { set_seed(seed); }
+
+  void set_seed(unsigned long long seed)
+  {
+    state = seed ? seed : 88172645463325252ULL;  //state must never be 0.
+  }
+
+  unsigned long long next()
+  {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+  }
+
+  int operator()(int n) { return (next() >> 32) % n; }
+};
+#endif
@@ -35,40 +35,88 @@
 
 const int MAXSIZE = 19;
 const int MAXSIZE2 = MAXSIZE*MAXSIZE;
+//Points are numbered on a board padded with a row of border points below and above,
+//and a border column shared by the left and right edges: (x, y), counted from 0 at
+//A1, is point (y+1)*(size+1) + x+1. Point 0 is off the board, and stands for pass.
+const int MAXPOINTS = (MAXSIZE+2)*(MAXSIZE+1) + 1;
+
+//Extent of the padded board and offsets to the neighbours of a point, border
+//points included. Board sizes known at compile time get them as constants,
+//so loops over them can be unrolled; Topology<0> holds them for any size.
+template<int N> struct Topology{
+  static constexpr int size = N, size2 = N*N;
+  static constexpr int stride = N + 1, npoints = (N + 2)*(N + 1) + 1;
+  static constexpr int maxpoints = npoints, maxsize2 = size2;  //To size arrays.
+  static constexpr int adjacent[4] = {stride, 1, -stride, -1};  //N, E, S, W.
+  static constexpr int diagonals[4] = {stride - 1, stride + 1,  //NW, NE, SE, SW.
+                                       1 - stride, -stride - 1};
+  static constexpr int vicinity[16] = {  //Clockwise from NW, twice to calculate rotations.
+    stride - 1, stride, stride + 1, 1, 1 - stride, -stride, -stride - 1, -1,
+    stride - 1, stride, stride + 1, 1, 1 - stride, -stride, -stride - 1, -1};
+  Topology(int) {}
+};
+
+template<int N> constexpr int Topology<N>::size;
+template<int N> constexpr int Topology<N>::size2;
+template<int N> constexpr int Topology<N>::stride;
+template<int N> constexpr int Topology<N>::npoints;
+template<int N> constexpr int Topology<N>::maxpoints;
+template<int N> constexpr int Topology<N>::maxsize2;
+template<int N> constexpr int Topology<N>::adjacent[4];
+template<int N> constexpr int Topology<N>::diagonals[4];
+template<int N> constexpr int Topology<N>::vicinity[16];
+
+template<> struct Topology<0>{
+  static constexpr int maxpoints = MAXPOINTS, maxsize2 = MAXSIZE2;
+  int size, size2, stride, npoints;
+  int adjacent[4], diagonals[4], vicinity[16];
+  Topology(int n): size(n), size2(n*n), stride(n + 1), npoints((n + 2)*(n + 1) + 1)
+  {
+    const int around[8] = {stride - 1, stride, stride + 1, 1,
+                           1 - stride, -stride, -stride - 1, -1};
+    for (int i = 0; i < 16; i++) {
+      vicinity[i] = around[i % 8];
+    }
+    for (int i = 0; i < 4; i++) {
+      adjacent[i] = around[2*i + 1];
+      diagonals[i] = around[2*i];
+    }
+  }
+};
 
 const char COORDINATES[] = {'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T'};
 
 const int handicap19[][9]= {
-  {61, 301, 289, 73,  175, 187, 67, 295, 181},
-  {61, 301, 289, 73,  175, 187, 67, 295, 0},
-  {61, 301, 289, 73,  175, 187, 181, 0, 0},
-  {61, 301, 289, 73,  175, 187, 0, 0, 0},
-  {61, 301, 289, 73,  181, 0, 0, 0, 0},
-  {61, 301, 289, 73,  0, 0, 0, 0, 0},
-  {61, 301, 289, 0, 0, 0, 0, 0, 0},
-  {61, 301, 0, 0, 0, 0, 0, 0, 0}
+  {84, 336, 324, 96,  204, 216, 90, 330, 210},
+  {84, 336, 324, 96,  204, 216, 90, 330, 0},
+  {84, 336, 324, 96,  204, 216, 210, 0, 0},
+  {84, 336, 324, 96,  204, 216, 0, 0, 0},
+  {84, 336, 324, 96,  210, 0, 0, 0, 0},
+  {84, 336, 324, 96,  0, 0, 0, 0, 0},
+  {84, 336, 324, 0, 0, 0, 0, 0, 0},
+  {84, 336, 0, 0, 0, 0, 0, 0, 0}
 };
 
 const int handicap13[][9]= {
-  {43, 127, 121, 49,  82, 88, 46, 124, 85},
-  {43, 127, 121, 49,  82, 88, 46, 124, 0},
-  {43, 127, 121, 49,  82, 88, 85, 0, 0},
-  {43, 127, 121, 49,  82, 88, 0, 0, 0},
-  {43, 127, 121, 49,  85, 0, 0, 0, 0},
-  {43, 127, 121, 49,  0, 0, 0, 0, 0},
-  {43, 127, 121, 0, 0, 0, 0, 0, 0},
-  {43, 127, 0, 0, 0, 0, 0, 0, 0}
+  {60, 150, 144, 66,  102, 108, 63, 147, 105},
+  {60, 150, 144, 66,  102, 108, 63, 147, 0},
+  {60, 150, 144, 66,  102, 108, 105, 0, 0},
+  {60, 150, 144, 66,  102, 108, 0, 0, 0},
+  {60, 150, 144, 66,  105, 0, 0, 0, 0},
+  {60, 150, 144, 66,  0, 0, 0, 0, 0},
+  {60, 150, 144, 0, 0, 0, 0, 0, 0},
+  {60, 150, 0, 0, 0, 0, 0, 0, 0}
 };
 
 const int handicap9[][9] = {
-  {21, 61, 57, 25,  39, 43, 23, 59, 41},
-  {21, 61, 57, 25,  39, 43, 23, 59, 0},
-  {21, 61, 57, 25,  39, 43, 41, 0, 0},
-  {21, 61, 57, 25,  39, 43, 0, 0, 0},
-  {21, 61, 57, 25,  41, 0, 0, 0, 0},
-  {21, 61, 57, 25,  0, 0, 0, 0, 0},
-  {21, 61, 57, 0, 0, 0, 0, 0, 0},
-  {21, 61, 0, 0, 0, 0, 0, 0, 0}
+  {33, 77, 73, 37,  53, 57, 35, 75, 55},
+  {33, 77, 73, 37,  53, 57, 35, 75, 0},
+  {33, 77, 73, 37,  53, 57, 55, 0, 0},
+  {33, 77, 73, 37,  53, 57, 0, 0, 0},
+  {33, 77, 73, 37,  55, 0, 0, 0, 0},
+  {33, 77, 73, 37,  0, 0, 0, 0, 0},
+  {33, 77, 73, 0, 0, 0, 0, 0, 0},
+  {33, 77, 0, 0, 0, 0, 0, 0, 0}
 };
 
 static void coord_to_char(int coord, std::string &response, int size){
@@ -76,8 +124,8 @@ static void coord_to_char(int coord, std::string &response, int size){
     response.append("pass");
   }
   else{
-    int y = (coord - 1)/size + 1;
-    int x = (coord - 1) % size;
+    int y = coord/(size + 1);
+    int x = coord % (size + 1) - 1;
     std::string auxstring;
     std::stringstream auxstream;
     auxstream << COORDINATES[x];
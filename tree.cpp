@@ -29,11 +29,32 @@
 ***************************************************************************************/
 #include "tree.h"
 #include <cmath>
+#include <algorithm>
+#include <new>
+#include <cstring>
+#include <fstream>
+#include <sys/mman.h>
+
+//Visits added to a node while a thread is playing out below it, so that
+//other threads are steered towards different lines.
+const double VIRTUAL_LOSS = 1.0;
+const double RAVE_BIAS = 1.0/3000, UCTK = 0.0;
+//Progressive widening: childs selectable with no visits, and more of them
+//as the square root of visits grows.
+const int WIDEN_MIN = 5;
+
+static void atomic_add(std::atomic<float> &value, float delta)
+{
+  float old = value.load(std::memory_order_relaxed);
+  while (!value.compare_exchange_weak(old, old + delta, std::memory_order_relaxed)) {
+  }
+}
 
 void Node::reset()
 {
   child = 0;
-  sibling = 0;
+  nchilds = 0;
+  expanding = false;
   visits = 0;
   results = 0;
   rave_visits = 0;
@@ -44,25 +65,21 @@ void Node::reset()
 void Node::copy_values(const Node *orig)
  {
   child = 0;
-  sibling = 0;
-  visits = orig->visits;
-  results = orig->results;
-  rave_visits = orig->rave_visits;
-  rave_results = orig->rave_results;
-  prior_visits = orig->prior_visits;
-  prior_results = orig->prior_results;
+  nchilds = 0;
+  expanding = false;  //Copies have no childs yet: set_childs() marks them expanded.
+  visits = orig->get_visits();
+  results = orig->get_results();
+  rave_visits = orig->get_rave_visits();
+  rave_results = orig->get_rave_results();
   move = orig->move;
  }
 
-void Node::add_child(Node *child)
+void Node::add_values(const Node *orig)
 {
-  if (!this->child)  this->child = child;
-  else {
-    Node *next;
-    for (next = this->child; next->sibling; next = next->sibling) {
-    }
-    next->sibling = child;
-  }
+  atomic_add(visits, orig->get_visits());
+  atomic_add(results, orig->get_results());
+  atomic_add(rave_visits, orig->get_rave_visits());
+  atomic_add(rave_results, orig->get_rave_results());
 }
 
 void Node::set_move(int mv, const Prior &prior)
@@ -70,188 +87,498 @@ void Node::set_move(int mv, const Prior &prior)
   move = mv;
   rave_results = prior.prior;
   rave_visits = prior.equiv;
-  prior_results = prior.prior;
-  prior_visits = prior.equiv;
 }
 
-void Node::set_results(int result)
+void Node::set_results(int wins, int nplayouts, bool virtual_loss)
 {
-  visits++;
-  results += result;
+  atomic_add(visits, virtual_loss ? nplayouts - VIRTUAL_LOSS : nplayouts);
+  if (wins) atomic_add(results, wins);
+}
+
+void Node::revert_virtual_loss()
+{
+  atomic_add(visits, -VIRTUAL_LOSS);
 }
 
 void Node::set_amaf(int result, const AmafBoard &amaf, bool side, int depth)
 {
-  const double discount = 0.0; //0.0001;
-  for (Node *next = child; next; next = next->sibling) {
-    next->rave_results += result * amaf.value(next->move, depth, side, discount);
-    next->rave_visits += amaf.value(next->move, depth, side, discount);
+  //RAVE statistics are only a guide, and are updated for every child on the path:
+  //an update lost to a concurrent thread is cheaper than a compare-and-swap here.
+  Node *childs = get_child();
+  if (childs == 0) return;
+  const int *first = amaf.entries(side);
+  int threshold = amaf.threshold(depth);
+  for (Node *next = childs; next != childs + nchilds; next++) {
+    if (first[next->move] >= threshold) {
+      if (result) next->rave_results.store(next->get_rave_results() + 1, std::memory_order_relaxed);
+      next->rave_visits.store(next->get_rave_visits() + 1, std::memory_order_relaxed);
+    }
   }
 }
 
+//Blend of the UCT and RAVE means, beta*rave_mean + (1-beta)*mean, with
+//beta = rave_visits/(rave_visits + visits + rave_visits*visits*RAVE_BIAS).
+//Both terms share that denominator, so it takes one division. Without RAVE
+//statistics, it is the plain mean, and without any, the first play urgency.
+static inline double blend(double visits, double results,
+                           double rave_visits, double rave_results)
+{
+  double weight = rave_visits + visits + rave_visits*visits*RAVE_BIAS;
+  if (weight == 0) return 1.0;
+  return ((1.0 + rave_visits*RAVE_BIAS)*results + rave_results)/weight;
+}
+
 double Node::get_value(double parent_visits) const
 {
-  const double BIAS = 1.0/3000, UCTK = 0.0;
-  if (visits) {
-    if (rave_visits) {
-      double beta = rave_visits/(rave_visits + visits + rave_visits*visits*BIAS);
-      return (1.0-beta)*results/visits + beta*rave_results/rave_visits;
-    } else {
-      return results/visits + UCTK*sqrt(log(parent_visits)/visits);
-    }
-  } else if (rave_visits) {
-      return rave_results/rave_visits;
-  }
-  return 1.0;   //first player urgency.
+  double visits = get_visits(), rave_visits = get_rave_visits();
+  double value = blend(visits, get_results(), rave_visits, get_rave_results());
+  if (UCTK && visits && !rave_visits) value += UCTK*sqrt(log(parent_visits)/visits);
+  return value;
+}
+
+//Childs are sorted by prior, and only the first ones can be selected: the
+//search widens from the most promising moves as the node gets visits.
+int Node::get_width() const
+{
+  int width = WIDEN_MIN + int(sqrt(get_visits()));
+  return width < nchilds ? width : nchilds;
 }
 
-Node *Node::select_child() const
+//Same values as get_value(), but every child's statistics are loaded once,
+//and the logarithm of the parent's visits is taken once for all of them.
+Node *Node::select_child()
 {
+  Node *childs = get_child();
+  if (childs == 0) return 0;
+  double log_parent = UCTK ? log(get_visits()) : 0;
   double best_value = -1;
   Node *RAVE_child = 0;
-  for (Node *next = child; next; next = next->sibling) {
-    if (next->get_value(visits) > best_value) {
-      best_value = next->get_value(visits);
+  Node *end = childs + get_width();  //Once: visits may go down meanwhile.
+  for (Node *next = childs; next < end; next++) {
+    double visits = next->get_visits(), rave_visits = next->get_rave_visits();
+    double value = blend(visits, next->get_results(), rave_visits, next->get_rave_results());
+    if (UCTK && visits && !rave_visits) value += UCTK*sqrt(log_parent/visits);
+    if (value > best_value) {
+      best_value = value;
       RAVE_child = next;
     }
   }
+  if (RAVE_child) atomic_add(RAVE_child->visits, VIRTUAL_LOSS);
   return RAVE_child;
 }
 
+//The most visited child. RAVE statistics start from the priors, so they
+//only decide among childs that have no visits yet.
 Node *Node::get_best_child() const
 {
   //return select_child();
-  Node *best_child = 0;
-  double best_visits = 0;
-  for (Node *next = child; next; next = next->sibling) {
-    double curr_visits = next->visits + next->rave_visits;
+  Node *best_child = 0, *RAVE_child = 0;
+  double best_visits = 0, best_rave_visits = 0;
+  Node *childs = get_child();
+  if (childs == 0) return 0;
+  Node *end = childs + get_width();
+  for (Node *next = childs; next < end; next++) {
+    double curr_visits = next->get_visits(), rave_visits = next->get_rave_visits();
     if (curr_visits > best_visits) {
       best_visits = curr_visits;
       best_child= next;
     }
+    if (rave_visits > best_rave_visits) {
+      best_rave_visits = rave_visits;
+      RAVE_child = next;
+    }
   }
-  return best_child;
+  return best_child ? best_child : RAVE_child;
 }
 
-void Node::print(int boardsize) const
+//Tree storage is only reserved address space: the system commits its pages as
+//they are first written, and takes them back when they are released, so that
+//resident memory follows the size of the tree rather than its maximum.
+//Descents jump all over it, so it is backed by huge pages when possible, to
+//spare TLB misses: transparent ones, which need regions aligned to them.
+//With HUGETLB, the pool is tried first; its pages are committed up front,
+//so that a pool too small fails here rather than with a SIGBUS later.
+const size_t HUGE_PAGE = 2 << 20;
+
+static size_t reserved_size(size_t bytes)
 {
-  std::string mv;
-  coord_to_char(move, mv, boardsize);
-    std::cerr.precision(4);
-    std::cerr << std::right << std::setw(4) << mv
-     << ": " << std::right << std::setw(6) << results/visits
-     << "/" << std::left << std::setw(5) << visits
-     << "[ RAVE: " << std::right<< std::setw(6) << rave_results/rave_visits
-     << "/" << std::left << std::setw(5) << rave_visits
-     << " Prior: " << std::right << std::setw(6) << prior_results/prior_visits
-     << "/" << std::left << std::setw(5) << prior_visits << "]\n";
+  return (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
 }
 
-Tree::Tree(int maxsize, Goban *goban)
+//madvise() takes MADV_HUGEPAGE even where transparent huge pages are
+//disabled, so the system setting tells whether they will back the tree.
+static bool transparent_pages_enabled()
 {
-  active = 0;
-  this->maxsize = maxsize;
+  std::ifstream enabled("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string modes;
+  std::getline(enabled, modes);
+  return modes.find("[always]") != std::string::npos
+      || modes.find("[madvise]") != std::string::npos;
+}
+
+static void *reserve_memory(size_t bytes, int &pages)
+{
+  bytes = reserved_size(bytes);
+  void *memory;
+#ifdef HUGETLB
+  memory = mmap(0, bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (memory != MAP_FAILED) {
+    pages = Tree::HUGETLB_PAGES;
+    return memory;
+  }
+#endif
+  memory = mmap(0, bytes + HUGE_PAGE, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (memory == MAP_FAILED) throw std::bad_alloc();
+  char *start = static_cast<char*>(memory);
+  char *aligned = reinterpret_cast<char*>(reserved_size(reinterpret_cast<size_t>(start)));
+  if (aligned > start) munmap(start, aligned - start);
+  munmap(aligned + bytes, start + HUGE_PAGE - aligned);
+  pages = madvise(aligned, bytes, MADV_HUGEPAGE) == 0 && transparent_pages_enabled()
+          ? Tree::TRANSPARENT_PAGES : Tree::SMALL_PAGES;
+  return aligned;
+}
+
+//Released pages read as zeros when touched again.
+static void release_memory(void *memory, size_t bytes)
+{
+  if (madvise(memory, reserved_size(bytes), MADV_DONTNEED)) {
+    memset(memory, 0, bytes);  //Huge pages of old kernels can not be released.
+  }
+}
+
+Tree::Tree(size_t memory, const Board *goban, int prune_visits)
+{
+  this->prune_visits = prune_visits;
   this->goban = goban;
-  root[0] = new Node[maxsize];
-  root[1] = new Node[maxsize];
-  root[0]->reset();
-  root[1]->reset();
-  size[0] = 1;
-  size[1] = 1;
+  map_buffers(memory);
 }
 
 Tree::~Tree()
 {
-  delete[] root[0];
-  delete[] root[1];
+  unmap_buffers();
+}
+
+//The tree takes memory bytes: its two buffers of nodes and their info, and
+//the transposition table.
+void Tree::map_buffers(size_t memory)
+{
+  active = 0;
+  size_t node_bytes = 2*(sizeof(Node) + sizeof(NodeInfo));
+#ifdef TRANSPOSITIONS
+  node_bytes += sizeof(Transposition)/8;  //Up to twice maxsize/16 entries.
+#endif
+  maxsize = std::max<size_t>(memory/node_bytes, 2*(MAXSIZE2+1));
+  for (int i = 0; i < 2; i++) {
+    nodes[i] = static_cast<Node*>(reserve_memory(maxsize*sizeof(Node), node_pages[i]));
+    info[i] = static_cast<NodeInfo*>(reserve_memory(maxsize*sizeof(NodeInfo), info_pages[i]));
+    size[i] = 0;
+  }
+#ifdef TRANSPOSITIONS
+  //About one entry per expanded node: childs come in blocks of dozens.
+  unsigned nentries = 1;
+  while (nentries < maxsize/16u) nentries *= 2;
+  table = static_cast<Transposition*>(reserve_memory(nentries*sizeof(Transposition), table_pages));
+  table_mask = nentries - 1;
+#endif
+  clear();
+}
+
+void Tree::unmap_buffers()
+{
+  for (int i = 0; i < 2; i++) {
+    munmap(nodes[i], reserved_size(maxsize*sizeof(Node)));
+    munmap(info[i], reserved_size(maxsize*sizeof(NodeInfo)));
+  }
+#ifdef TRANSPOSITIONS
+  munmap(table, reserved_size((table_mask + 1)*sizeof(Transposition)));
+#endif
+}
+
+//Maps the tree again, empty, with a new budget. Not safe while searching.
+void Tree::set_memory(size_t memory)
+{
+  unmap_buffers();
+  map_buffers(memory);
+}
+
+NodeInfo &Tree::get_info(const Node *node) const
+{
+  int i = (node >= nodes[0] && node < nodes[0] + maxsize) ? 0 : 1;
+  return info[i][node - nodes[i]];
+}
+
+//Gives the pages of buffer i back to the system.
+void Tree::release(int i)
+{
+  release_memory(nodes[i], size[i]*sizeof(Node));
+  release_memory(info[i], size[i]*sizeof(NodeInfo));
 }
 
 void Tree::clear()
 {
   active = 0;
-  root[0]->reset();
-  root[1]->reset();
+  root = nodes[0];
+  root_depth = 0;
+  for (int i = 0; i < 2; i++) {
+    release(i);
+    nodes[i]->reset();
+    info[i][0].prior_visits = 0, info[i][0].prior_results = 0;
+  }
   size[0] = 1;
   size[1] = 1;
+#ifdef TRANSPOSITIONS
+  clear_table();
+#endif
 }
 
 void Tree::clear_active()
 {
+  release(active);
   size[active] = 1;
-  root[active]->reset();
+  nodes[active]->reset();
+#ifdef TRANSPOSITIONS
+  clear_table();  //Its nodes are gone, and the other buffer is about to be active.
+#endif
+}
+
+#ifdef TRANSPOSITIONS
+void Tree::clear_table()
+{  //Entries with first == 0 are empty.
+  release_memory(table, (table_mask + 1)*sizeof(Transposition));
+}
+#endif
+
+Node *Tree::allocate(int n)
+{  //Reserves n consecutive nodes of the active tree; safe to call from any thread.
+  int first = size[active].load(std::memory_order_relaxed);
+  do {
+    if (first + n > maxsize) return 0;
+  } while (!size[active].compare_exchange_weak(first, first + n, std::memory_order_relaxed));
+  return nodes[active] + first;
 }
 
-Node *Tree::insert(Node *parent, int move, const Prior &prior)
+//Copies the subtree below orig under parent, in the inactive tree, laid out
+//for the descents to come: each block of childs is followed by the subtrees
+//of its childs, most visited first, so the main lines are contiguous. Childs
+//of nodes with less than min_visits visits are dropped, and may be expanded
+//again. Blocks shared by transpositions are copied once: copies maps them.
+void Tree::copy_recursive(Node *parent, const Node *orig, int min_visits,
+                          std::unordered_map<const Node*, Node*> &copies)
 {
-  if (size[active] < maxsize) {
-    Node *child = root[active] + size[active]++;
-    child->reset();
-    parent->add_child(child);
-    child->set_move(move, prior);
-    return child;
-  } else {
+  const Node *orig_childs = orig->get_child();
+  if (orig_childs == 0) return;
+  if (orig->get_visits() < min_visits) {
+    parent->drop_childs();
+    return;
+  }
+  int nchilds = orig->get_nchilds();
+  Node *&childs = copies[orig_childs];
+  if (childs) {
+    parent->set_childs(childs, nchilds);
+    return;
+  }
+  if (size[1-active] + nchilds > maxsize) {
     std::cerr << "WARNING: Out of memory!\n";
-    return 0;
+    parent->drop_childs();
+    return;
+  }
+  childs = nodes[1-active] + size[1-active];
+  size[1-active] += nchilds;
+  int order[MAXSIZE2+1];
+  for (int i = 0; i < nchilds; i++) {
+    childs[i].copy_values(&orig_childs[i]);
+    get_info(&childs[i]) = get_info(&orig_childs[i]);
+    order[i] = i;
+  }
+  parent->set_childs(childs, nchilds);
+  std::stable_sort(order, order + nchilds, [orig_childs](int a, int b) {
+    return orig_childs[a].get_visits() > orig_childs[b].get_visits();
+  });
+  for (int i = 0; i < nchilds; i++) {
+    copy_recursive(&childs[order[i]], &orig_childs[order[i]], min_visits, copies);
   }
 }
 
-Node *Tree::insert(Node *parent, const Node *orig)
+static Node *find_child(Node *childs, int nchilds, int move)
 {
-  if (size[1-active] < maxsize) {
-    Node *child = root[1-active] + size[1-active]++;
-    child->copy_values(orig);
-    parent->add_child(child);
-    return child;
-  } else {
-    std::cerr << "WARNING: Out of memory!\n";
-    return 0;
+  for (int i = 0; i < nchilds; i++) {
+    if (childs[i].get_move() == move) return &childs[i];
   }
+  return 0;
 }
 
-void Tree::copy_recursive(Node *parent, const Node *orig)
+//Adds the statistics of the root childs of other to ours, so that get_best()
+//chooses among the merged results of several independent searches.
+void Tree::merge(const Tree *other)
 {
-  for (Node *node = orig->get_child(); node; node = node->get_sibling()) {
-    Node *child = insert(parent, node);
-    if (child) copy_recursive(child, node);
+  const Node *other_root = other->get_root();
+  root->add_values(other_root);
+  const Node *orig = other_root->get_child();
+  if (orig == 0) return;
+  int norig = other_root->get_nchilds();
+  Node *childs = root->get_child();
+  int nchilds = childs ? root->get_nchilds() : 0;
+  const Node *missing[MAXSIZE2+1];
+  int nmissing = 0;
+  for (int i = 0; i < norig; i++) {
+    Node *node = find_child(childs, nchilds, orig[i].get_move());
+    if (node) node->add_values(&orig[i]);
+    else missing[nmissing++] = &orig[i];
   }
+  if (nmissing == 0) return;
+
+  //Childs must be consecutive: with new moves, they all move to a larger block.
+  Node *grown = allocate(nchilds + nmissing);
+  if (grown == 0) {
+    std::cerr << "WARNING: Out of memory!\n";
+    return;
+  }
+  for (int i = 0; i < nchilds; i++) {
+    grown[i].copy_values(&childs[i]);
+    get_info(&grown[i]) = get_info(&childs[i]);
+  }
+  for (int i = 0; i < nmissing; i++) {
+    grown[nchilds + i].copy_values(missing[i]);
+    get_info(&grown[nchilds + i]) = other->get_info(missing[i]);
+  }
+  root->set_childs(grown, nchilds + nmissing);
 }
 
+//The child for new_root becomes the root, where it is: whatever the size of
+//the tree, this takes no time. The rest of the tree is left for collect().
 int Tree::promote(int new_root)
 {
-  for (Node *n = root[active]->get_child(); n; n = n->get_sibling()) {
-    if (n->get_move() == new_root) {
-      root[1-active]->copy_values(n);
-      copy_recursive(root[1-active], n);
-      clear_active();
-      active = 1-active;
-      return active;
-    }
+  Node *childs = root->get_child();
+  Node *n = childs ? find_child(childs, root->get_nchilds(), new_root) : 0;
+  if (n == 0) {
+    clear();
+    return active;
   }
-  clear();
+  root = n;
+  root_depth++;
   return active;
 }
 
-int Tree::expand(Node *parent, const int *moves, int nmovs, const Prior priors[])
+//Copies the nodes reachable from the root to the other buffer, which becomes
+//the active one. Childs of nodes with less than min_visits are left behind.
+//Not safe while searching.
+void Tree::compact(int min_visits)
+{
+  Node *new_root = nodes[1-active];
+  size[1-active] = 1;
+  new_root->copy_values(root);
+  get_info(new_root) = get_info(root);
+  std::unordered_map<const Node*, Node*> copies;
+  copy_recursive(new_root, root, min_visits, copies);
+  clear_active();
+  active = 1-active;
+  root = new_root;
+}
+
+//Compacts the tree if promotions have left unreachable nodes in more than
+//half of the active buffer.
+void Tree::collect()
+{
+  if (root == nodes[active] || size[active] < maxsize/2) return;
+  compact(prune_visits);
+}
+
+//Makes room in a full tree, for the search to go on: the least visited
+//subtrees are dropped, raising the bar until at least half the tree is free.
+//Their nodes keep their statistics, and are expanded again if visited enough.
+void Tree::reclaim()
+{
+  int min_visits = std::max(prune_visits, 1);
+  compact(min_visits);
+  while (size[active] > maxsize/2) {
+    min_visits *= 2;
+    compact(min_visits);
+  }
+}
+
+//Gives parent, claimed for expansion, the childs of an expanded node of the
+//same situation, if any. Returns false if parent still has to be expanded.
+bool Tree::transpose(Node *parent, unsigned long long key, int depth)
+{
+#ifdef TRANSPOSITIONS
+  const Transposition &entry = table[key & table_mask];
+  unsigned long long data = entry.data.load(std::memory_order_acquire);
+  unsigned long long check = entry.check.load(std::memory_order_relaxed);
+  int first = data >> 32, nchilds = data & 0xffff;
+  if (first == 0 || (check ^ data) != key
+      || int(data >> 16 & 0xffff) != ((root_depth + depth) & 0xffff)) {
+    return false;
+  }
+  parent->set_childs(nodes[active] + first, nchilds);
+  return true;
+#else
+  return false;
+#endif
+}
+
+//Expands parent, once claimed with claim_expansion(). Returns -1 if the
+//tree is full, and then parent can be claimed again.
+int Tree::expand(Node *parent, const int *moves, int nmovs, const Prior priors[],
+                 unsigned long long key, int depth)
 {
-  //if (parent->has_childs()) return 0; //No need to expand, but we check before calling.
+  Node *childs = allocate(nmovs);
+  if (childs == 0) {  //The tree is full: reclaim() will make room.
+    parent->release_expansion();
+    return -1;
+  }
+  int sorted[MAXSIZE2+1];  //By prior mean, for progressive widening.
+  std::copy(moves, moves + nmovs, sorted);
+  std::stable_sort(sorted, sorted + nmovs, [priors](int a, int b) {
+    return priors[a].prior*priors[b].equiv > priors[b].prior*priors[a].equiv;
+  });
   for (int i = 0; i < nmovs; i++) {
-    if (insert(parent, moves[i], priors[moves[i]]) == 0) {  //Out of memory.
-      return -1;
-    }
+    const Prior &prior = priors[sorted[i]];
+    childs[i].reset();
+    childs[i].set_move(sorted[i], prior);
+    NodeInfo &child_info = get_info(&childs[i]);
+    child_info.prior_visits = prior.equiv;
+    child_info.prior_results = prior.prior;
   }
+  parent->set_childs(childs, nmovs);
+#ifdef TRANSPOSITIONS
+  //Depth from the root of the cleared tree: promotions keep it.
+  unsigned long long data = (unsigned long long)(childs - nodes[active]) << 32
+                          | ((root_depth + depth) & 0xffff) << 16 | nmovs;
+  Transposition &entry = table[key & table_mask];
+  entry.check.store(key ^ data, std::memory_order_relaxed);
+  entry.data.store(data, std::memory_order_release);
+#endif
   return 0;
 }
 
+void Tree::print_node(const Node *node) const
+{
+  const NodeInfo &node_info = get_info(node);
+  std::string mv;
+  coord_to_char(node->get_move(), mv, goban->get_size());
+    std::cerr.precision(4);
+    std::cerr << std::right << std::setw(4) << mv
+     << ": " << std::right << std::setw(6) << node->get_results()/node->get_visits()
+     << "/" << std::left << std::setw(5) << node->get_visits()
+     << "[ RAVE: " << std::right<< std::setw(6) << node->get_rave_results()/node->get_rave_visits()
+     << "/" << std::left << std::setw(5) << node->get_rave_visits()
+     << " Prior: " << std::right << std::setw(6) << node_info.prior_results/node_info.prior_visits
+     << "/" << std::left << std::setw(5) << node_info.prior_visits << "]\n";
+}
+
 void Tree::print(Node *node, int threshold, int depth) const
 {
   for (int i = 0; i < depth; i++) std::cerr << "  ";
   std::cerr << "|->";
-  node->print(goban->get_size());
+  print_node(node);
   
-  Node *childs[MAXSIZE2] = {0};
+  Node *childs[MAXSIZE2+1] = {0};
   int len = 0;
-  for (Node *child = node->get_child(); child; child=child->get_sibling()) {
-    if (child->get_visits() >= threshold) childs[len++] = child;
+  Node *first = node->get_child();
+  for (int i = 0; first && i < node->get_nchilds(); i++) {
+    if (first[i].get_visits() >= threshold) childs[len++] = &first[i];
   }
 
   while (true) {
@@ -270,19 +597,30 @@ void Tree::print(Node *node, int threshold, int depth) const
 
 void Tree::print() const
 {
-  int threshold = root[active]->get_visits()/30;
+  int threshold = root->get_visits()/30;
   std::string sp = "  ";
-  std::cerr << "Active tree: " << active << " " << get_size() <<" nodes.\n";
-  print(root[active], threshold, 0);
+  const char *page_names[] = {"small", "transparent huge", "hugetlb"};
+  std::cerr << "Active tree: " << active << " " << get_size() << " nodes. Pages: nodes "
+            << page_names[node_pages[0]] << "/" << page_names[node_pages[1]]
+            << ", info " << page_names[info_pages[0]] << "/" << page_names[info_pages[1]];
+#ifdef TRANSPOSITIONS
+  std::cerr << ", table " << page_names[table_pages];
+#endif
+  std::cerr << ".\n";
+  print(root, threshold, 0);
 
   Node *best = get_best();
+  if (best == 0) {
+    std::cerr << "#No childs expanded.\n";
+    return;
+  }
   std::cerr << "#Expected: " << best->get_value(1) << ", visits "
             << best->get_visits() << " PV:\n";
 
   bool side = !goban->get_side();
-  for (Node *n = root[active]->get_best_child(); n; n = n->get_best_child()) {
+  for (Node *n = root->get_best_child(); n; n = n->get_best_child()) {
       side ? std::cerr << "B" :  std::cerr << "W";
-      n->print(goban->get_size());
+      print_node(n);
       side = !side;
   }
   std::cerr << "\n";
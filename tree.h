@@ -29,59 +29,129 @@
 ***************************************************************************************/
 #ifndef TREEH
 #define TREEH
+#include <atomic>
+#include <unordered_map>
 #include "amaf.h"
 #include "goban.h"
 
+#define TRANSPOSITIONS
+//Map the tree from the hugetlb pool when it can hold it, committing it whole:
+//#define HUGETLB
+
+//Nodes are shared by all search threads: statistics are atomics, and children
+//are published with a single store of 'child' once they are fully set up.
+//The children of a node are consecutive in the tree; 'child' is the offset
+//of the first one from the node itself, or 0. Nodes are kept small, so that
+//more of them fit in memory and in cache: what is only printed is in NodeInfo.
 class Node{
 private:
-  int move;
-  double visits, results;
-  double rave_visits, rave_results;
-  double prior_visits, prior_results;
-  Node *child, *sibling;
+  std::atomic<float> visits, results;
+  std::atomic<float> rave_visits, rave_results;
+  std::atomic<int> child;
+  short nchilds;  //Set before child is published.
+  short move;
+  std::atomic<bool> expanding;
 public:
   void reset();
   void copy_values(const Node *orig);
-  void add_child(Node *child);
+  void drop_childs() { child = 0, nchilds = 0, expanding = false; }  //Before it is shared.
+  void add_values(const Node *orig);
+  void set_childs(Node *first, int n)
+  {
+    expanding.store(true, std::memory_order_relaxed);  //Claimed, if it was not.
+    nchilds = n;
+    child.store(first - this, std::memory_order_release);
+  }
+  bool claim_expansion() { return !expanding.exchange(true); }
+  void release_expansion() { expanding = false; }
   void set_move(int, const Prior &prior);
-  void set_results(int result);
+  void set_results(int wins, int nplayouts, bool virtual_loss);
+  void revert_virtual_loss();
   void set_amaf(int result, const AmafBoard &amaf, bool side, int depth);
   
   int get_move() const{ return move; }
-  double get_results() const{ return results; };
-  double get_visits() const{ return visits; };
-  double get_rave_results() const{ return rave_results; };
-  double get_rave_visits() const{ return rave_visits; };
-  Node *get_child() const{ return child; }
-  Node *get_sibling() const{ return sibling; }
-  void print(int boardsize) const;
+  double get_results() const{ return results.load(std::memory_order_relaxed); };
+  double get_visits() const{ return visits.load(std::memory_order_relaxed); };
+  double get_rave_results() const{ return rave_results.load(std::memory_order_relaxed); };
+  double get_rave_visits() const{ return rave_visits.load(std::memory_order_relaxed); };
+  Node *get_child() const
+  {
+    int offset = child.load(std::memory_order_acquire);
+    return offset ? const_cast<Node*>(this) + offset : 0;
+  }
+  int get_nchilds() const{ return nchilds; }  //Only valid once get_child() is set.
+  int get_width() const;  //Childs that can be selected, the same way.
 
-  bool has_childs() const{ return child != 0; };
+  bool has_childs() const{ return child.load(std::memory_order_acquire) != 0; };
   double get_value(double parent_visits) const;
-  Node *select_child() const;
+  Node *select_child();
   Node *get_best_child() const;
+};
 
-
+//Prior the statistics of a node started from; only shown by Tree::print().
+struct NodeInfo{
+  float prior_visits, prior_results;
 };
 
+//Nodes are allocated from the active one of two buffers, which only take
+//memory as they fill up. Promotion just moves
+//the root down, and the nodes left unreachable are reclaimed by collect(),
+//which copies the reachable ones to the other buffer when it is worth it.
 class Tree{
 private:
-  Node *root[2];
-  int size[2], maxsize, active;
-  const Goban *goban;
+  Node *nodes[2];
+  NodeInfo *info[2];  //info[i][n] belongs to nodes[i][n].
+  Node *root;
+  std::atomic<int> size[2];
+  int maxsize, active;
+  int root_depth;  //Moves the root has been promoted since the tree was cleared.
+  int prune_visits;  //collect() drops the childs of nodes with fewer visits.
+  int node_pages[2], info_pages[2], table_pages;  //What each buffer is backed by.
+  const Board *goban;
+  void map_buffers(size_t memory);
+  void unmap_buffers();
+  void release(int i);
+  void compact(int min_visits);
+#ifdef TRANSPOSITIONS
+  //Childs of the positions expanded in the active tree, by situation key, so
+  //that nodes reached by different move orders share them. Only nodes at the
+  //same depth share childs, which keeps the tree a DAG, without cycles.
+  //Entries take no lock: data packs the first child (an index in the active
+  //tree, 0 for none), the depth and the number of childs, and check is the
+  //key xor data, so that an entry torn by concurrent writes does not match.
+  struct Transposition{
+    std::atomic<unsigned long long> check, data;
+  };
+  Transposition *table;
+  unsigned table_mask;
+  void clear_table();
+#endif
+  Node *allocate(int n);
+  NodeInfo &get_info(const Node *node) const;
+  void print_node(const Node *node) const;
 public:
-  Tree(int maxsize, Goban *goban);
+  enum {SMALL_PAGES, TRANSPARENT_PAGES, HUGETLB_PAGES};
+  Tree(size_t memory, const Board *goban, int prune_visits);
   ~Tree();
+  void set_memory(size_t memory);
   void clear();
   void clear_active();
   int promote(int new_root);
-  Node *insert(Node *parent, int move, const Prior &prior);
-  Node *insert(Node *parent, const Node *orig);
-  void copy_recursive(Node *parent, const Node *orig);
-  int expand(Node *parent, const int *moves, int nmoves, const Prior[]);
-  Node *get_best() const{ return root[active]->get_best_child(); }
-  Node *get_root() const{ return root[active]; }
+  void collect();
+  void reclaim();
+  void copy_recursive(Node *parent, const Node *orig, int min_visits,
+                      std::unordered_map<const Node*, Node*> &copies);
+  void merge(const Tree *other);
+  bool transpose(Node *parent, unsigned long long key, int depth);
+  int expand(Node *parent, const int *moves, int nmoves, const Prior[],
+             unsigned long long key, int depth);
+  Node *get_best() const{ return root->get_best_child(); }
+  Node *get_root() const{ return root; }
   int get_size() const{ return size[active];}
+  void set_prune_visits(int visits) { prune_visits = visits; }
+  bool is_full() const{ return size[active] + MAXSIZE2+1 > maxsize; }
+  //Nodes are expanded after more visits as the tree fills up.
+  int expand_visits(int visits) const{ return visits << 4*size[active]/maxsize; }
   void print() const;
   void print(Node *node, int threshold, int depth) const;
 };
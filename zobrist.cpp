@@ -29,15 +29,25 @@
 ***************************************************************************************/
 #include "zobrist.h"
 
-Zobrist::Zobrist()
+unsigned long long Zobrist::zob_side;
+unsigned long long Zobrist::zob_points[2][MAXPOINTS];
+unsigned long long Zobrist::zob_ko[MAXPOINTS];
+
+bool Zobrist::init_tables()
 {
-  zob_key = 0;
   zob_side = genrand64_int64();
-  for(int i = 0; i < MAXSIZE2; i++){
+  for(int i = 0; i < MAXPOINTS; i++){
     zob_points [0][i] = genrand64_int64();
     zob_points [1][i] = genrand64_int64();
     zob_ko[i] = genrand64_int64();
   }
+  return true;
+}
+
+Zobrist::Zobrist()
+{
+  static bool tables = init_tables();
+  zob_key = 0;
   clear_history();
 }
 
@@ -46,6 +56,17 @@ unsigned long long Zobrist::get_key() const
   return zob_key;  
 }
 
+//Key of the position together with the side to move and the ko point: positions
+//with the same key have the same legal moves, but for superko.
+unsigned long long Zobrist::get_key(bool side, int ko_point) const
+{
+  unsigned long long key = zob_key ^ zob_ko[ko_point];
+#ifndef SITUATIONAL_SUPERKO
+  if(side) key ^= zob_side;
+#endif
+  return key;
+}
+
 void Zobrist::set_key(unsigned long long key)
 {
   zob_key = key;
@@ -71,7 +92,7 @@ void Zobrist::toggle_ko(int ko_point)
 
 void Zobrist::update(int point, bool color)
 {
-  if(point) zob_key ^= zob_points[color][point-1];
+  if(point) zob_key ^= zob_points[color][point];
 }
 
 void Zobrist::update(const int *moves, const int moves_len)
@@ -79,7 +100,7 @@ void Zobrist::update(const int *moves, const int moves_len)
   bool side = 0;
   reset();
   for(int i = 0; i < moves_len; i++){
-    if(moves[i]) zob_key ^= zob_points[side][moves[i]-1];
+    if(moves[i]) zob_key ^= zob_points[side][moves[i]];
     side = !side;
   }
   if(side) zob_key ^= zob_side;
@@ -36,14 +36,17 @@
 class Zobrist{
 private:
   unsigned long long zob_key;
-  unsigned long long zob_side;
-  unsigned long long zob_points[2][MAXSIZE2];
-  unsigned long long zob_ko[MAXSIZE2];
+  //Shared by every board, so that the keys of a position are the same on all:
+  static unsigned long long zob_side;
+  static unsigned long long zob_points[2][MAXPOINTS];
+  static unsigned long long zob_ko[MAXPOINTS];
   unsigned long long zob_history[6];
   int active;
+  static bool init_tables();
 public:
   Zobrist();
   unsigned long long get_key() const;
+  unsigned long long get_key(bool side, int ko_point) const;
   void set_key(unsigned long long);
   void reset();
   void toggle_side();